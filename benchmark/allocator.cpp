@@ -0,0 +1,82 @@
+#include "prompt.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+
+// Function: random_words
+// Generate words over a small alphabet so that they share prefixes like command names do.
+// Draws come straight from the engine output, which unlike the std distributions is the same 
+// on every toolchain.
+template <typename C>
+std::vector<C> random_words(size_t num, std::mt19937& gen){
+  std::vector<C> words;
+  words.reserve(num);
+  for(size_t i=0; i<num; ++i){
+    C w;
+    for(size_t j=4+gen()%21; j>0; --j){
+      w.push_back(static_cast<char>('a'+gen()%8));
+    }
+    words.push_back(std::move(w));
+  }
+  return words;
+}
+
+// Function: measure
+// Return the milliseconds to insert all words into a fresh tree and destroy it
+template <typename C, typename... A>
+double measure(const std::vector<C>& words, size_t rounds, A&&... alloc){
+  auto beg = std::chrono::steady_clock::now();
+  for(size_t r=0; r<rounds; ++r){
+    prompt::RadixTree<C> tree(alloc...);
+    for(const auto& w: words){
+      tree.insert(w);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - beg).count() / rounds;
+}
+
+int main(){
+
+  std::cout << std::left << std::setw(10) << "words"
+            << std::right << std::setw(14) << "default(ms)"
+            << std::setw(14) << "pool(ms)"
+            << std::setw(14) << "arena(ms)"
+            << std::setw(10) << "speedup\n";
+
+  std::mt19937 gen(0);
+
+  for(size_t num : {1000, 10000, 100000, 1000000}){
+    
+    auto words = random_words<std::string>(num, gen);
+    std::vector<std::pmr::string> pmr_words(words.begin(), words.end());
+
+    const size_t rounds {std::max(size_t{1}, 1000000 / num)};
+
+    // Global operator new for every node, label and child table
+    auto heap = measure(words, rounds);
+
+    // Pool reused across rounds: freed blocks are recycled by size class
+    std::pmr::unsynchronized_pool_resource pool;
+    auto pooled = measure(pmr_words, rounds, &pool);
+
+    // Arena released as a whole after each round; destruction returns nothing to it
+    double arena {0};
+    for(size_t r=0; r<rounds; ++r){
+      std::pmr::monotonic_buffer_resource buffer;
+      arena += measure(pmr_words, 1, &buffer);
+    }
+    arena /= rounds;
+
+    std::cout << std::left << std::setw(10) << num 
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(14) << heap
+              << std::setw(14) << pooled
+              << std::setw(14) << arena
+              << std::setw(9) << std::setprecision(2) << heap / arena << "x\n";
+  }
+
+  return 0;
+}
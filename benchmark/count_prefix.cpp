@@ -0,0 +1,74 @@
+#include "prompt.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Reference scalar loop, the implementation count_prefix had before vectorization
+template <typename C>
+size_t scalar_count_prefix(
+  std::basic_string_view<typename C::value_type, typename C::traits_type> s1, 
+  std::basic_string_view<typename C::value_type, typename C::traits_type> s2){
+  size_t i {0};
+  size_t len {std::min(s1.size(), s2.size())};
+  for(; i<len; ++i){
+    if(s1[i] != s2[i]){
+      break;
+    }
+  }
+  return i;
+}
+
+// Function: measure
+// Return the nanoseconds per call of f over label pairs that differ only in the last code unit
+template <typename F>
+double measure(F&& f, size_t rounds){
+  size_t sink {0};
+  auto beg = std::chrono::steady_clock::now();
+  for(size_t r=0; r<rounds; ++r){
+    sink += f(r);
+  }
+  auto end = std::chrono::steady_clock::now();
+  // Keep the result alive so the loop is not optimized away
+  if(sink == 0){
+    std::cerr << "";
+  }
+  return std::chrono::duration<double, std::nano>(end - beg).count() / rounds;
+}
+
+template <typename C>
+void bench_type(const char* name){
+  for(size_t len : {4, 16, 64, 256, 1024}){
+    // Alternate the mismatch position a little so both loops take the same branches each round
+    C a(len, 'a');
+    C b(len, 'a');
+    b.back() = 'b';
+    std::basic_string_view<typename C::value_type, typename C::traits_type> va{a}, vb{b};
+    const size_t rounds {(1u << 24) / len};
+
+    auto scalar = measure([&](size_t r){ 
+      return scalar_count_prefix<C>(va, vb.substr(0, len - (r & 1))); 
+    }, rounds);
+    auto vector = measure([&](size_t r){ 
+      return prompt::count_prefix<C>(va, vb.substr(0, len - (r & 1))); 
+    }, rounds);
+
+    std::cout << std::left << std::setw(16) << name 
+              << std::right << std::setw(8) << len
+              << std::setw(14) << std::fixed << std::setprecision(2) << scalar
+              << std::setw(14) << vector
+              << std::setw(10) << scalar / vector << "x\n";
+  }
+}
+
+int main(){
+  std::cout << std::left << std::setw(16) << "type" 
+            << std::right << std::setw(8) << "length"
+            << std::setw(14) << "scalar(ns)"
+            << std::setw(14) << "simd(ns)"
+            << std::setw(11) << "speedup\n";
+  bench_type<std::string>("string");
+  bench_type<std::wstring>("wstring");
+  bench_type<std::u16string>("u16string");
+  bench_type<std::u32string>("u32string");
+  return 0;
+}
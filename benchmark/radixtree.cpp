@@ -0,0 +1,260 @@
+// Benchmark suite of RadixTree on reproducible datasets. Prints one CSV row per dataset, 
+// size and operation to stdout so results can be compared across versions:
+//
+//   ./bench [max_words] > result.csv
+//
+// Sizes go from 1e3 up to max_words by powers of ten (default 1e6, up to 1e7).
+
+#include "prompt.hpp"
+#include "unittest/counting_resource.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <sys/resource.h>
+
+// Function: peak_rss_kb
+// Return the peak resident set size of the process so far
+size_t peak_rss_kb(){
+  rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss);
+}
+
+// Function: fnv1a
+// 32-bit FNV-1a hash of s; unlike std::hash its value is the same on every toolchain
+uint32_t fnv1a(std::string_view s){
+  uint32_t h {2166136261u};
+  for(auto c: s){
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return h;
+}
+
+// Function: draw
+// Uniform integer in [lo, hi] taken straight from the engine output. mt19937 output is fixed 
+// by the standard but the std distributions are not, so datasets only use these draws.
+size_t draw(std::mt19937& gen, size_t lo, size_t hi){
+  return lo + static_cast<size_t>(gen()) % (hi - lo + 1);
+}
+
+// Procedure: shuffle
+// Fisher-Yates shuffle on draw, in place of std::shuffle
+template <typename T>
+void shuffle(std::vector<T>& v, std::mt19937& gen){
+  for(size_t i=v.size(); i>1; --i){
+    std::swap(v[i-1], v[draw(gen, 0, i-1)]);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Datasets
+// ------------------------------------------------------------------------------------------------
+
+const std::vector<std::string> vocabulary {
+  "get", "set", "read", "write", "report", "update", "create", "delete", "find", "load",
+  "save", "parse", "dump", "init", "reset", "check", "build", "insert", "remove", "clear",
+  "timing", "path", "cell", "net", "pin", "port", "clock", "delay", "slack", "lib",
+  "verilog", "spef", "sdc", "design", "module", "instance", "graph", "node", "edge", "tree",
+  "max", "min", "rise", "fall", "early", "late", "input", "output", "count", "size"
+};
+
+// Procedure: random_words
+// Uniform lowercase words of 5 to 20 letters: few shared prefixes, wide root
+std::vector<std::string> random_words(size_t num, std::mt19937& gen){
+  std::vector<std::string> words(num);
+  for(auto& w: words){
+    for(size_t i=draw(gen, 5, 20); i>0; --i){
+      w.push_back(static_cast<char>(draw(gen, 'a', 'z')));
+    }
+  }
+  return words;
+}
+
+// Procedure: shared_prefix_words
+// Words behind a handful of long common stems with a small alphabet: deep, narrow tree
+std::vector<std::string> shared_prefix_words(size_t num, std::mt19937& gen){
+  std::vector<std::string> words(num);
+  for(auto& w: words){
+    w = "common_prefix_of_all_words_" + std::to_string(draw(gen, 0, 7)) + "_";
+    for(size_t i=draw(gen, 4, 16); i>0; --i){
+      w.push_back(static_cast<char>(draw(gen, 'a', 'd')));
+    }
+  }
+  return words;
+}
+
+// Procedure: identifier_words
+// Snake-case identifiers of two to four vocabulary words and an optional number, like the 
+// command and function names a shell completes
+std::vector<std::string> identifier_words(size_t num, std::mt19937& gen){
+  std::vector<std::string> words(num);
+  for(auto& w: words){
+    w = vocabulary[draw(gen, 0, vocabulary.size()-1)];
+    for(size_t i=draw(gen, 2, 4); i>1; --i){
+      w.append("_").append(vocabulary[draw(gen, 0, vocabulary.size()-1)]);
+    }
+    if(auto n = draw(gen, 0, 999); n < 500){
+      w.append(std::to_string(n));
+    }
+  }
+  return words;
+}
+
+// Procedure: path_words
+// Absolute file paths of two to six directories below a few roots
+std::vector<std::string> path_words(size_t num, std::mt19937& gen){
+  const std::vector<std::string> roots {"/usr/lib", "/usr/include", "/home/user/project", "/tmp"};
+  const std::vector<std::string> exts {".cpp", ".hpp", ".v", ".lib", ".txt"};
+  std::vector<std::string> words(num);
+  for(auto& w: words){
+    w = roots[draw(gen, 0, roots.size()-1)];
+    for(size_t i=draw(gen, 2, 6); i>0; --i){
+      w.append("/").append(vocabulary[draw(gen, 0, vocabulary.size()-1)]);
+    }
+    w.append(std::to_string(draw(gen, 0, 99))).append(exts[draw(gen, 0, exts.size()-1)]);
+  }
+  return words;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Measurement
+// ------------------------------------------------------------------------------------------------
+
+// Procedure: report
+// Print one CSV row
+void report(
+  const std::string& dataset, size_t num_words, size_t num_unique, const std::string& op, 
+  size_t num_ops, double seconds, double bytes_per_word
+){
+  std::cout << dataset << ',' << num_words << ',' << num_unique << ',' << op << ',' 
+            << num_ops << ',' << seconds * 1e9 / num_ops << ',' << num_ops / seconds << ',' 
+            << peak_rss_kb() << ',' << bytes_per_word << '\n' << std::flush;
+}
+
+// Function: seconds
+// Return the seconds taken by f
+template <typename F>
+double seconds(F&& f){
+  auto beg = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - beg).count();
+}
+
+// Procedure: run
+// Benchmark every operation on one dataset
+void run(const std::string& dataset, const std::vector<std::string>& words, std::mt19937& gen){
+
+  // Tree bytes per distinct word, counted by building the same tree on a counting resource
+  double bytes_per_word {0};
+  size_t num_unique {0};
+  {
+    CountingResource counter;
+    std::vector<std::pmr::string> pmr_words(words.begin(), words.end());
+    prompt::RadixTree<std::pmr::string> tree(pmr_words, &counter);
+    num_unique = tree.count_prefix_matches({});
+    bytes_per_word = static_cast<double>(counter.outstanding) / num_unique;
+  }
+
+  size_t sink {0};
+
+  // Incremental insert
+  prompt::RadixTree<std::string> tree;
+  report(dataset, words.size(), num_unique, "insert", words.size(), seconds([&](){
+    for(const auto& w: words){
+      tree.insert(w);
+    }
+  }), bytes_per_word);
+
+  // Bulk load from unsorted words (includes the sort)
+  report(dataset, words.size(), num_unique, "bulk_load", words.size(), seconds([&](){
+    prompt::RadixTree<std::string> bulk(words);
+    sink += bulk.root().num_words;
+  }), bytes_per_word);
+
+  // Parallel build on all hardware threads
+  report(dataset, words.size(), num_unique, "parallel_build", words.size(), seconds([&](){
+    prompt::RadixTree<std::string> parallel(
+      words.begin(), words.end(), std::max(1u, std::thread::hardware_concurrency())
+    );
+    sink += parallel.root().num_words;
+  }), bytes_per_word);
+
+  // Lookups of present words in random order and of absent words
+  std::vector<std::string> queries(words);
+  shuffle(queries, gen);
+  report(dataset, words.size(), num_unique, "exist_hit", queries.size(), seconds([&](){
+    for(const auto& q: queries){
+      sink += tree.exist(q);
+    }
+  }), bytes_per_word);
+
+  for(auto& q: queries){
+    q.back() = '#';
+  }
+  report(dataset, words.size(), num_unique, "exist_miss", queries.size(), seconds([&](){
+    for(const auto& q: queries){
+      sink += tree.exist(q);
+    }
+  }), bytes_per_word);
+
+  // Prefix queries as a user types them: words with their last few code units dropped
+  const size_t num_prefix {std::min(words.size(), size_t{10000})};
+  std::vector<std::string> prefixes;
+  for(size_t i=0; i<num_prefix; ++i){
+    prefixes.push_back(words[i].substr(0, words[i].size() - std::min(words[i].size()-1, size_t{4})));
+  }
+  report(dataset, words.size(), num_unique, "match_prefix", prefixes.size(), seconds([&](){
+    for(const auto& p: prefixes){
+      sink += tree.match_prefix(p).size();
+    }
+  }), bytes_per_word);
+
+  // First page of matches, as listed by one TAB
+  report(dataset, words.size(), num_unique, "match_prefix_page", prefixes.size(), seconds([&](){
+    for(const auto& p: prefixes){
+      sink += tree.match_prefix(p, 0, 100).size();
+    }
+  }), bytes_per_word);
+
+  report(dataset, words.size(), num_unique, "count_prefix_matches", prefixes.size(), seconds([&](){
+    for(const auto& p: prefixes){
+      sink += tree.count_prefix_matches(p);
+    }
+  }), bytes_per_word);
+
+  // Full enumeration, one op per word
+  report(dataset, words.size(), num_unique, "all_words", num_unique, seconds([&](){
+    sink += tree.all_words().size();
+  }), bytes_per_word);
+
+  if(sink == 0){
+    std::cerr << "unexpected empty results\n";
+  }
+}
+
+int main(int argc, char* argv[]){
+
+  const size_t max_words = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+  const std::vector<std::pair<std::string, std::vector<std::string>(*)(size_t, std::mt19937&)>> 
+  datasets {
+    {"random", random_words},
+    {"shared_prefix", shared_prefix_words},
+    {"identifier", identifier_words},
+    {"path", path_words}
+  };
+
+  std::cout << "dataset,words,unique,op,ops,ns_per_op,ops_per_sec,peak_rss_kb,bytes_per_word\n";
+
+  for(const auto& [name, generate]: datasets){
+    for(size_t num=1000; num<=max_words; num*=10){
+      // Seeded per dataset and size so every run sees the same words
+      std::mt19937 gen(static_cast<uint32_t>(num) ^ fnv1a(name));
+      run(name, generate(num, gen), gen);
+    }
+  }
+
+  return 0;
+}
@@ -1,5 +1,8 @@
 #include "prompt.hpp"
 
+// Built-in commands are sorted at compile time and need no tree nodes
+static constexpr auto builtins = prompt::make_word_table("help", "history", "exit");
+
 int main(){
   prompt::Prompt shell(
     "Welcome to Prompt", 
@@ -10,6 +13,7 @@ int main(){
   shell.autocomplete("read_celllib");
   shell.autocomplete("asia");
   shell.autocomplete("american");
+  shell.autocomplete(builtins);
 
   std::string line;
 
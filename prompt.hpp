@@ -26,6 +26,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <termios.h>
 #include <pwd.h>
 #include <errno.h>
@@ -35,20 +37,46 @@
 #include <sstream>
 #include <iostream>
 #include <memory>
-#include <list>
+#include <memory_resource>
+#include <queue>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <numeric>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <unordered_map>
 #include <vector>
+#include <array>
 #include <cstring>
 #include <fstream>
 #include <string_view>
-#include <experimental/filesystem>
 #include <cassert>
-
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+#else
+#include <experimental/filesystem>
 
 namespace std {
 
 namespace filesystem = experimental::filesystem;
 
 };
+#endif
 
 // ------------------------------------------------------------------------------------------------
 
@@ -101,22 +129,629 @@ std::basic_istream<C, T>& read_line(
   return is;
 }
 
+// Function: find_last_byte
+// Return a pointer to the last occurrence of c in the first n bytes of data, or nullptr. 
+// memrchr is a GNU and BSD extension; elsewhere the bytes are scanned backwards one by one.
+inline const char* find_last_byte(const char* data, char c, size_t n){
+#if defined(_GNU_SOURCE) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+  return static_cast<const char*>(::memrchr(data, c, n));
+#else
+  while(n > 0){
+    if(data[--n] == c){
+      return data + n;
+    }
+  }
+  return nullptr;
+#endif
+}
+
+// Function: read_tail_lines
+// Visit the last num lines of a file, oldest first, as string views; lines end at '\n' as 
+// with std::getline. The file is read backwards with pread in chunks that double in size, 
+// and each chunk is scanned backwards (see find_last_byte), so only its tail is read 
+// however long it is. Nothing is mapped: another process truncating or replacing the file 
+// meanwhile makes the read fail instead of faulting. Returns true if the file holds more 
+// than num lines.
+template <typename V>
+bool read_tail_lines(const std::filesystem::path& path, size_t num, V&& visitor){
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd == -1){
+    return false;
+  }
+
+  struct stat st;
+  if(::fstat(fd, &st) == -1 or st.st_size == 0){
+    ::close(fd);
+    return false;
+  }
+  if(num == 0){
+    ::close(fd);
+    return true;
+  }
+
+  // The buffer holds the file from off to its end. A trailing '\n' does not open a line, 
+  // so the scan stops at num newlines before it, or at the start of the file.
+  std::string buf, block;
+  size_t off = st.st_size;
+  size_t chunk {4096};
+  size_t found {0};
+  size_t beg {0};
+  while(found < num and off > 0){
+    const size_t len = std::min(chunk, off);
+    block.resize(len);
+    for(size_t got=0; got<len; ){
+      const auto n = ::pread(fd, block.data() + got, len - got, off - len + got);
+      if(n < 0 and errno == EINTR){
+        continue;
+      }
+      if(n <= 0){  // read error, or the file shrank under us
+        ::close(fd);
+        return false;
+      }
+      got += n;
+    }
+    const bool first {buf.empty()};
+    block.append(buf);
+    buf.swap(block);
+    off -= len;
+    chunk *= 2;
+
+    size_t end = len - (first and buf.back() == '\n');
+    while(found < num){
+      const char* nl = find_last_byte(buf.data(), '\n', end);
+      if(nl == nullptr){
+        break;
+      }
+      end = nl - buf.data();
+      if(++found == num){
+        beg = end + 1;
+      }
+    }
+  }
+  ::close(fd);
+
+  // With fewer than num newlines the whole file was read and its first line is kept too
+  const bool more {found == num};
+  const size_t count = more ? num : found + 1;
+
+  // Visit the lines forward
+  const size_t last = buf.size() - (buf.back() == '\n');
+  for(size_t i=0; i<count; ++i){
+    auto nl = static_cast<const char*>(std::memchr(buf.data() + beg, '\n', last - beg));
+    const size_t len = nl ? nl - (buf.data() + beg) : last - beg;
+    visitor(std::string_view(buf.data() + beg, len));
+    beg += len + 1;
+  }
+
+  return more;
+}
+
 // ------------------------------------------------------------------------------------------------
 
+// Function: mismatch_code_unit
+// Return the index of the first position where a and b differ, or n if the first n code units 
+// are equal. The widest vector unit enabled at compile time (AVX2, then SSE2) compares 32 or 16 
+// bytes per step and the remaining tail falls back to the scalar loop.
+template <typename T>
+size_t mismatch_code_unit(const T* a, const T* b, size_t n){
+  size_t i {0};
+  if constexpr(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4){
+#if defined(__AVX2__)
+    for(; i+32/sizeof(T)<=n; i+=32/sizeof(T)){
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a+i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b+i));
+      // Byte-wise compare is enough: the first differing byte lies in the first differing unit
+      auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+      if(mask != 0xFFFFFFFFu){
+        return i + __builtin_ctz(~mask) / sizeof(T);
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i+16/sizeof(T)<=n; i+=16/sizeof(T)){
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a+i));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b+i));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+      if(mask != 0xFFFFu){
+        return i + __builtin_ctz(~mask & 0xFFFFu) / sizeof(T);
+      }
+    }
+#endif
+  }
+  for(; i<n; ++i){
+    if(a[i] != b[i]){
+      break;
+    }
+  }
+  return i;
+}
+
+// Struct: NoFold
+// Folding policy that compares code units as they are. A policy whose variants(c) lists 
+// every code unit that folds like c sets enumerable for that code unit type, so trees look 
+// those units up instead of scanning every edge.
+struct NoFold {
+  template <typename T>
+  static constexpr bool enumerable {true};
+
+  template <typename T>
+  static constexpr T fold(T c) { return c; }
+
+  template <typename T>
+  static constexpr std::array<T, 2> variants(T c) { return {c, c}; }
+};
+
+// Struct: AsciiFold
+// Folding policy that maps the ASCII upper-case letters to lower case
+struct AsciiFold {
+  template <typename T>
+  static constexpr bool enumerable {true};
+
+  template <typename T>
+  static constexpr T fold(T c) { 
+    return (c >= T('A') and c <= T('Z')) ? static_cast<T>(c - T('A') + T('a')) : c; 
+  }
+
+  template <typename T>
+  static constexpr std::array<T, 2> variants(T c) {
+    const auto f = fold(c);
+    return {f, (f >= T('a') and f <= T('z')) ? static_cast<T>(f - T('a') + T('A')) : f};
+  }
+};
+
+// Struct: SimpleCaseFold
+// Folding policy that applies the Unicode simple case folding of the Latin-1, Latin 
+// Extended-A, Greek and Cyrillic blocks to UTF-16 and UTF-32 code units. Single-byte code 
+// units are UTF-8 and only their ASCII letters are folded. Wide code units are not 
+// enumerable: several of them can fold alike (e.g., the three sigmas).
+struct SimpleCaseFold {
+  template <typename T>
+  static constexpr bool enumerable {sizeof(T) == 1};
+
+  template <typename T>
+  static constexpr std::array<T, 2> variants(T c) { return AsciiFold::variants(c); }
+
+  template <typename T>
+  static constexpr T fold(T c) {
+    const auto u = static_cast<uint32_t>(static_cast<std::make_unsigned_t<T>>(c));
+    if(u < 0x80 or sizeof(T) == 1){
+      return AsciiFold::fold(c);
+    }
+    uint32_t f {u};
+    if(u >= 0xC0 and u <= 0xDE and u != 0xD7){                             // Latin-1
+      f = u + 0x20;
+    }
+    else if((u >= 0x100 and u <= 0x12F) or (u >= 0x132 and u <= 0x137) or 
+            (u >= 0x14A and u <= 0x177)){                                  // Latin Extended-A
+      f = u | 1;
+    }
+    else if((u >= 0x139 and u <= 0x148) or (u >= 0x179 and u <= 0x17E)){
+      f = (u & 1) ? u + 1 : u;
+    }
+    else if(u == 0x178){
+      f = 0xFF;
+    }
+    else if(u >= 0x391 and u <= 0x3A9 and u != 0x3A2){                     // Greek
+      f = u + 0x20;
+    }
+    else if(u == 0x3C2){                                                   // final sigma
+      f = 0x3C3;
+    }
+    else if(u >= 0x410 and u <= 0x42F){                                    // Cyrillic
+      f = u + 0x20;
+    }
+    else if(u >= 0x400 and u <= 0x40F){
+      f = u + 0x50;
+    }
+    return static_cast<T>(f);
+  }
+};
+
 // Function: count_prefix  
-// Count the the length of same prefix between two strings
-template <typename C>
-constexpr size_t count_prefix(
+// Count the the length of same prefix between two strings. Code units are compared after 
+// the folding policy F maps them, one at a time; without folding the vector path is used.
+template <typename C, typename F = NoFold>
+size_t count_prefix(
   std::basic_string_view<typename C::value_type, typename C::traits_type> s1, 
   std::basic_string_view<typename C::value_type, typename C::traits_type> s2){
+  const size_t len {std::min(s1.size(), s2.size())};
+  if constexpr(std::is_same_v<F, NoFold>){
+    return mismatch_code_unit(s1.data(), s2.data(), len);
+  }
+  else{
+    size_t i {0};
+    for(; i<len and F::fold(s1[i]) == F::fold(s2[i]); ++i);
+    return i;
+  }
+}
+
+// Function: edit_distance
+// Return the Levenshtein distance between two strings, or max_edits+1 as soon as it is 
+// known to exceed max_edits. Only the band of max_edits diagonals is computed.
+template <typename C>
+size_t edit_distance(
+  std::basic_string_view<typename C::value_type, typename C::traits_type> s1, 
+  std::basic_string_view<typename C::value_type, typename C::traits_type> s2,
+  size_t max_edits){
+  const size_t over {max_edits + 1};
+  if((s1.size() > s2.size() ? s1.size() - s2.size() : s2.size() - s1.size()) > max_edits){
+    return over;
+  }
+  std::vector<size_t> prev(s2.size() + 1), curr(s2.size() + 1);
+  for(size_t j=0; j<=s2.size(); ++j){
+    prev[j] = std::min(j, over);
+  }
+  for(size_t i=1; i<=s1.size(); ++i){
+    const size_t lo {i > max_edits ? i - max_edits : 1};
+    const size_t hi {std::min(s2.size(), i + max_edits)};
+    curr[lo-1] = lo == 1 ? std::min(i, over) : over;
+    size_t row_min {curr[lo-1]};
+    for(size_t j=lo; j<=hi; ++j){
+      curr[j] = std::min({prev[j] + 1, curr[j-1] + 1, prev[j-1] + (s1[i-1] != s2[j-1]), over});
+      row_min = std::min(row_min, curr[j]);
+    }
+    if(hi < s2.size()){
+      curr[hi+1] = over;
+    }
+    if(row_min >= over){
+      return over;
+    }
+    std::swap(prev, curr);
+  }
+  return prev[s2.size()];
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: find_code_unit
+// Return the index of the first key equal to k, or n if there is none. With SSE2 one vector 
+// compare tests 16, 8 or 4 keys at once depending on the width of the code unit.
+template <typename T>
+size_t find_code_unit(const T* keys, size_t n, T k){
   size_t i {0};
-  size_t len {std::min(s1.size(), s2.size())};
-  for(; i<len; ++i){
-    if(s1[i] != s2[i]){
-      break;
+#if defined(__SSE2__)
+  if constexpr(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4){
+    constexpr size_t lanes {16 / sizeof(T)};
+    __m128i key;
+    if constexpr(sizeof(T) == 1){
+      key = _mm_set1_epi8(static_cast<char>(k));
+    }
+    else if constexpr(sizeof(T) == 2){
+      key = _mm_set1_epi16(static_cast<short>(k));
+    }
+    else{
+      key = _mm_set1_epi32(static_cast<int>(k));
+    }
+    for(; i+lanes<=n; i+=lanes){
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys+i));
+      __m128i eq;
+      if constexpr(sizeof(T) == 1){
+        eq = _mm_cmpeq_epi8(v, key);
+      }
+      else if constexpr(sizeof(T) == 2){
+        eq = _mm_cmpeq_epi16(v, key);
+      }
+      else{
+        eq = _mm_cmpeq_epi32(v, key);
+      }
+      if(int mask = _mm_movemask_epi8(eq); mask != 0){
+        return i + __builtin_ctz(static_cast<unsigned>(mask)) / sizeof(T);
+      }
     }
   }
-  return i;
+#endif
+  for(; i<n; ++i){
+    if(keys[i] == k){
+      return i;
+    }
+  }
+  return n;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: RadixChildren
+// Child table of a radix tree node, keyed by the first code unit of each edge label. Edges are 
+// kept in insertion order and the lookup structure adapts to the fan-out like the node types 
+// of an adaptive radix tree:
+//   SMALL   (<= 4 edges)  : scalar scan of the key array
+//   NODE16  (<= 16 edges) : one vector compare of the key array
+//   NODE48  (<= 48 edges) : 256-entry byte index from key to slot
+//   NODE256 (>  48 edges) : 256-entry 16-bit index from key to slot
+// The 256-way indices cover code units below 256. Wider keys fall back to the vector compare.
+// The edge and key arrays and the indices are allocated with the allocator of C, and P is 
+// the owning pointer to a child.
+template <typename C, typename N, typename P = std::unique_ptr<N>>
+class RadixChildren{
+
+  using value_type     = typename C::value_type;
+  using allocator_type = typename C::allocator_type;
+  using edge_type      = std::pair<C, P>;
+
+  template <typename T>
+  using rebind_alloc = typename std::allocator_traits<allocator_type>::template rebind_alloc<T>;
+
+  public:
+
+    enum class Layout { SMALL, NODE16, NODE48, NODE256 };
+
+    using iterator       = typename std::vector<edge_type, rebind_alloc<edge_type>>::iterator;
+    using const_iterator = typename std::vector<edge_type, rebind_alloc<edge_type>>::const_iterator;
+
+    RadixChildren() = default;
+    explicit RadixChildren(const allocator_type& a) : _edges(a), _keys(a), _index48(a), _index256(a) {}
+
+    allocator_type get_allocator() const { return allocator_type(_edges.get_allocator()); }
+
+    iterator begin() { return _edges.begin(); }
+    iterator end() { return _edges.end(); }
+    const_iterator begin() const { return _edges.begin(); }
+    const_iterator end() const { return _edges.end(); }
+
+    size_t size() const { return _edges.size(); }
+    bool empty() const { return _edges.empty(); }
+
+    Layout layout() const;
+    size_t heap_bytes() const;
+
+    iterator find(value_type);
+    const_iterator find(value_type) const;
+
+    edge_type& emplace_back(C&&, P&&);
+    iterator erase(const_iterator);
+
+  private:
+
+    std::vector<edge_type, rebind_alloc<edge_type>> _edges;
+    std::vector<value_type, rebind_alloc<value_type>> _keys;  // first code unit of each edge
+
+    // key -> slot+1 (0 if absent); empty unless the layout uses the index
+    std::vector<uint8_t, rebind_alloc<uint8_t>> _index48;
+    std::vector<uint16_t, rebind_alloc<uint16_t>> _index256;
+
+    static constexpr size_t _small_max {4};
+    static constexpr size_t _node16_max {16};
+    static constexpr size_t _node48_max {48};
+
+    static uint32_t _ukey(value_type k) { 
+      return static_cast<std::make_unsigned_t<value_type>>(k); 
+    }
+
+    size_t _find(value_type) const;
+    void _build_index();
+};
+
+// Function: layout
+// Return the current lookup layout
+template <typename C, typename N, typename P>
+typename RadixChildren<C, N, P>::Layout RadixChildren<C, N, P>::layout() const {
+  if(not _index256.empty()) return Layout::NODE256;
+  if(not _index48.empty())  return Layout::NODE48;
+  return _edges.size() <= _small_max ? Layout::SMALL : Layout::NODE16;
+}
+
+// Function: _find
+// Return the slot of the edge starting with the given code unit, or size() if none
+template <typename C, typename N, typename P>
+size_t RadixChildren<C, N, P>::_find(value_type k) const {
+  if(const auto u = _ukey(k); u < 256){
+    if(not _index48.empty()){
+      return _index48[u] ? _index48[u] - 1 : _edges.size();
+    }
+    if(not _index256.empty()){
+      return _index256[u] ? _index256[u] - 1 : _edges.size();
+    }
+  }
+  if(_keys.size() <= _small_max){
+    for(size_t i=0; i<_keys.size(); ++i){
+      if(_keys[i] == k){
+        return i;
+      }
+    }
+    return _keys.size();
+  }
+  return find_code_unit(_keys.data(), _keys.size(), k);
+}
+
+// Function: find
+// Return the edge whose label starts with the given code unit
+template <typename C, typename N, typename P>
+typename RadixChildren<C, N, P>::iterator RadixChildren<C, N, P>::find(value_type k) {
+  return _edges.begin() + _find(k);
+}
+
+// Function: find
+// Return the edge whose label starts with the given code unit
+template <typename C, typename N, typename P>
+typename RadixChildren<C, N, P>::const_iterator RadixChildren<C, N, P>::find(value_type k) const {
+  return _edges.begin() + _find(k);
+}
+
+// Function: emplace_back
+// Append an edge. The caller guarantees no other edge shares the first code unit.
+template <typename C, typename N, typename P>
+typename RadixChildren<C, N, P>::edge_type& RadixChildren<C, N, P>::emplace_back(
+  C&& label, P&& child
+){
+  assert(not label.empty() and _find(label[0]) == _edges.size());
+  
+  _keys.push_back(label[0]);
+  auto& e = _edges.emplace_back(std::move(label), std::move(child));
+
+  if(const auto n = _edges.size(); n == _node16_max+1 or n == _node48_max+1){
+    _build_index();
+  }
+  else if(const auto u = _ukey(_keys.back()); u < 256){
+    if(not _index48.empty()) _index48[u] = n;
+    else if(not _index256.empty()) _index256[u] = n;
+  }
+  return e;
+}
+
+// Function: erase
+// Remove an edge and keep the order of the others. Spare capacity is released once 
+// the table has shrunk to a quarter of it.
+template <typename C, typename N, typename P>
+typename RadixChildren<C, N, P>::iterator RadixChildren<C, N, P>::erase(const_iterator itr){
+  const size_t slot = itr - _edges.begin();
+  _keys.erase(_keys.begin() + slot);
+  _edges.erase(_edges.begin() + slot);
+  if(_edges.size() < _edges.capacity() / 4){
+    _edges.shrink_to_fit();
+    _keys.shrink_to_fit();
+  }
+  _build_index();
+  return _edges.begin() + slot;
+}
+
+// Function: heap_bytes
+// Return the bytes held by the edge and key arrays and the 256-way index. Edge labels and 
+// children are not included.
+template <typename C, typename N, typename P>
+size_t RadixChildren<C, N, P>::heap_bytes() const {
+  return _edges.capacity() * sizeof(edge_type) + 
+         _keys.capacity() * sizeof(value_type) + 
+         _index48.capacity() * sizeof(uint8_t) + 
+         _index256.capacity() * sizeof(uint16_t);
+}
+
+// Procedure: _build_index
+// Grow the lookup structure to the 256-way index that fits the current fan-out
+template <typename C, typename N, typename P>
+void RadixChildren<C, N, P>::_build_index(){
+  if(_edges.size() <= _node48_max){
+    _index256.clear();
+    _index256.shrink_to_fit();
+  }
+  if(_edges.size() <= _node16_max or _edges.size() > _node48_max){
+    _index48.clear();
+    _index48.shrink_to_fit();
+  }
+  if(_edges.size() <= _node16_max){
+    return;
+  }
+  if(_edges.size() <= _node48_max){
+    _index48.assign(256, 0);
+  }
+  else{
+    _index256.assign(256, 0);
+  }
+  for(size_t i=0; i<_keys.size(); ++i){
+    if(const auto u = _ukey(_keys[i]); u < 256){
+      if(not _index48.empty()) _index48[u] = i+1;
+      else _index256[u] = i+1;
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Node algorithms shared by RadixTree and RadixMap. A node type N has a RadixChildren table 
+// named children; whether a node ends a word is up to the tree and passed in when needed. 
+// Taking N as a template parameter keeps the constness of the node the search starts from.
+
+// Function: search_prefix_node
+// Find the node that matches the given prefix, or nullptr. The second element is the 
+// remaining part of the last edge when the prefix ends in the middle of it.
+template <typename C, typename N>
+std::pair<N*, std::basic_string_view<typename C::value_type, typename C::traits_type>> 
+search_prefix_node(
+  N& root,
+  std::basic_string_view<typename C::value_type, typename C::traits_type> s
+){
+  using view_type = std::basic_string_view<typename C::value_type, typename C::traits_type>;
+
+  N* n = &root;
+  view_type suffix;
+  for(size_t pos=0; pos<s.size(); ){ // Search until full match
+    auto itr = n->children.find(s[pos]);
+    if(itr == n->children.end()){
+      return {nullptr, suffix};
+    }
+    auto& [k, v] = *itr;
+    auto num = count_prefix<C>(k, s.substr(pos));
+    if(pos += num; pos == s.size()){
+      suffix = view_type{k}.substr(num);
+    }
+    else if(num != k.size()){  // Mismatch in the middle of the edge
+      return {nullptr, suffix};
+    }
+    n = v.get();
+  }
+  return {n, suffix};
+}
+
+// Procedure: split_edge
+// Split an edge after its first num code units in place: the new parent, whose summary 
+// fields the caller has set, takes the slot and the first code unit of the edge, and the 
+// old child moves under it with the rest of the label.
+template <typename E, typename P>
+void split_edge(E& edge, size_t num, P parent){
+  auto& [k, v] = edge;
+  parent->children.emplace_back(std::decay_t<decltype(k)>(k, num, k.get_allocator()), std::move(v));
+  k.resize(num);
+  v = std::move(parent);
+}
+
+// Procedure: compact_edge
+// Fix the child behind an edge after a removal under it: a child that holds no word and 
+// has no children is dropped, and one with a single child is merged with it.
+template <typename N, typename I, typename W>
+void compact_edge(N& n, I itr, W&& holds_word){
+  auto& [k, v] = *itr;
+  if(holds_word(*v)){
+    return;
+  }
+  if(v->children.empty()){
+    n.children.erase(itr);
+  }
+  else if(v->children.size() == 1){
+    auto& [gk, gv] = *v->children.begin();
+    k += gk;
+    auto grandchild = std::move(gv);
+    v = std::move(grandchild);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+template <typename C>
+class FrozenRadixTree;
+
+// Struct: RadixTreeStats
+// Shape and memory summary of a RadixTree. Depths count edges from the root.
+struct RadixTreeStats {
+  size_t num_nodes {0};                 // including the root
+  size_t num_words {0};
+  size_t label_code_units {0};          // total length of all edge labels
+  size_t label_bytes {0};               // heap bytes of labels too long for the string buffer
+  size_t heap_bytes {0};                // estimated bytes of nodes, child tables and labels
+  size_t max_depth {0};                 // deepest node
+  double average_word_depth {0};        // edges walked by an exist() that succeeds
+  std::vector<size_t> depth_histogram;  // number of words at each depth
+  std::vector<size_t> fanout_histogram; // number of nodes with each number of children
+};
+
+// Function: operator<<
+// Write the stats on one line of key=value pairs, e.g. for a log
+inline std::ostream& operator<<(std::ostream& os, const RadixTreeStats& stats){
+  os << "nodes=" << stats.num_nodes 
+     << " words=" << stats.num_words
+     << " label_code_units=" << stats.label_code_units
+     << " label_bytes=" << stats.label_bytes
+     << " heap_bytes=" << stats.heap_bytes
+     << " max_depth=" << stats.max_depth
+     << " avg_word_depth=" << stats.average_word_depth
+     << " depth_histogram=[";
+  for(size_t i=0; i<stats.depth_histogram.size(); ++i){
+    os << (i ? "," : "") << stats.depth_histogram[i];
+  }
+  os << "] fanout_histogram=[";
+  for(size_t i=0; i<stats.fanout_histogram.size(); ++i){
+    os << (i ? "," : "") << stats.fanout_histogram[i];
+  }
+  return os << ']';
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -130,142 +765,810 @@ class RadixTree{
   using allocator_type = typename C::allocator_type;
 
   public:
+
+    struct Node;
+
+    // Return a node to the allocator its child table was created with
+    struct NodeDeleter {
+      void operator()(Node*) const;
+    };
+
+    using node_pointer = std::unique_ptr<Node, NodeDeleter>;
   
     struct Node {
+      Node() = default;
+      explicit Node(const allocator_type& a) : children(a) {}
       bool is_word {false};
-      std::list<std::pair<C, std::unique_ptr<Node>>> children;
+      size_t weight {0};        // weight of the word ending at this node
+      size_t max_weight {0};    // upper bound of the word weights in this subtree
+      size_t num_words {0};     // number of words in this subtree
+      RadixChildren<C, Node, node_pointer> children;
     };
 
    RadixTree() = default;
-   RadixTree(const std::vector<C>&);
+   explicit RadixTree(const allocator_type&);
+   RadixTree(const std::vector<C>&, const allocator_type& = allocator_type());
+
+   template <typename I>
+   RadixTree(I, I, const allocator_type& = allocator_type());
+
+   template <typename I>
+   RadixTree(I, I, size_t, const allocator_type& = allocator_type());
+
+   allocator_type get_allocator() const { return _alloc; }
    
    bool exist(std::basic_string_view<value_type, traits_type>) const;
    void insert(const C&);
+   void insert(const C&, size_t);
+
+   bool erase(std::basic_string_view<value_type, traits_type>);
+   bool erase_prefix(std::basic_string_view<value_type, traits_type>);
+
+   template <typename F>
+   bool exist(std::basic_string_view<value_type, traits_type>) const;
+
+   template <typename F>
+   size_t count_prefix_matches(std::basic_string_view<value_type, traits_type>) const;
+
+   template <typename F>
+   std::vector<C> match_prefix(std::basic_string_view<value_type, traits_type>) const;
+
+   template <typename F>
+   std::vector<C> match_prefix(std::basic_string_view<value_type, traits_type>, size_t, size_t) const;
+
+   template <typename F>
+   std::optional<C> common_prefix(std::basic_string_view<value_type, traits_type>) const;
   
-   std::vector<C> match_prefix(const C&) const;
+   std::vector<C> match_prefix(std::basic_string_view<value_type, traits_type>) const;
+   std::vector<C> match_prefix(std::basic_string_view<value_type, traits_type>, size_t, size_t) const;
+   size_t count_prefix_matches(std::basic_string_view<value_type, traits_type>) const;
+   std::optional<C> resolve_unique(std::basic_string_view<value_type, traits_type>) const;
+   std::vector<C> top_k(const C&, size_t) const;
+   std::optional<C> common_extension(std::basic_string_view<value_type, traits_type>) const;
+   std::vector<C> match_fuzzy(std::basic_string_view<value_type, traits_type>, size_t) const;
    std::vector<C> all_words() const;
    C dump() const;
+   void dump(std::basic_ostream<value_type, traits_type>&) const;
+
+   RadixTreeStats stats() const;
+
+   template <typename V>
+   bool for_each_prefix(std::basic_string_view<value_type, traits_type>, V&&) const;
+
+   FrozenRadixTree<C> freeze() const;
 
    const Node& root() const;
 
   private:
 
-   Node _root;
+   allocator_type _alloc;
+   Node _root {_alloc};
+
+   node_pointer _make_node();
+
+   // Whether a range yields references to strings that outlive the iteration, so that 
+   // bulk loading can keep views of them instead of copies
+   template <typename I>
+   static constexpr bool _stable_range = 
+     std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<I>::iterator_category> and 
+     std::is_lvalue_reference_v<typename std::iterator_traits<I>::reference>;
+
+   template <typename I>
+   void _load(I, I);
 
-   void _insert(std::basic_string_view<value_type, traits_type>, Node&);
-   void _match_prefix(std::vector<C>&, const Node&, const C&) const;
+   template <typename I>
+   void _load(I, I, size_t);
+
+   bool _concurrent_allocation() const;
+
+   void _insert_sorted(const std::vector<std::basic_string_view<value_type, traits_type>>&);
+   std::pair<bool, bool> _insert(
+     std::basic_string_view<value_type, traits_type>, Node&, std::optional<size_t>
+   );
+   void _update_aggregates(Node&);
+
+   bool _erase(std::basic_string_view<value_type, traits_type>, Node&);
+   bool _erase_prefix(std::basic_string_view<value_type, traits_type>, Node&);
+   void _compact(Node&, typename RadixChildren<C, Node, node_pointer>::iterator);
+
+   void _match_fuzzy(
+     const Node&, 
+     std::basic_string_view<value_type, traits_type>, 
+     size_t, 
+     C&, 
+     std::vector<size_t>&, 
+     std::vector<std::pair<size_t, C>>&
+   ) const;
    void _dump(const Node&, size_t, C&) const;
+   void _dump(const Node&, size_t, std::basic_ostream<value_type, traits_type>&) const;
+   void _stats(const Node&, size_t, RadixTreeStats&) const;
+
+   template <typename V>
+   bool _for_each_prefix(const Node&, C&, V&) const;
+
+   void _match_prefix(const Node&, C&, size_t&, size_t&, std::vector<C>&) const;
+
+   template <typename F, typename V>
+   void _search_folded(const Node&, std::basic_string_view<value_type, traits_type>, C*, V&) const;
   
-   std::pair<const Node*, C> _search_prefix_node(
+   std::pair<const Node*, std::basic_string_view<value_type, traits_type>> _search_prefix_node(
      std::basic_string_view<value_type, traits_type>
    ) const;
 };
 
 
 // Procedure: Ctor 
+// Create an empty tree whose nodes and edge labels are allocated with the given allocator
 template <typename C>
-RadixTree<C>::RadixTree(const std::vector<C>& words){
-  for(const auto& w: words){
-    insert(w);
-  }
+RadixTree<C>::RadixTree(const allocator_type& alloc) : _alloc(alloc) {
 }
 
-
-// Procedure: dump 
-// Dump the radix tree into a string 
+// Procedure: Ctor 
 template <typename C>
-C RadixTree<C>::dump() const {
-  C t;
-  _dump(_root, 0, t);      
-  t.append(1, '\n');
-  return t;
+RadixTree<C>::RadixTree(const std::vector<C>& words, const allocator_type& alloc) : 
+  RadixTree(words.begin(), words.end(), alloc) {
 }
 
-// Procedure: _dump 
-// Recursively traverse the tree and append each level to string 
+// Procedure: Ctor 
+// Build the tree from a range of words in one pass. Sorted input is loaded as is and 
+// other input is sorted first. Ranges that do not refer to lasting strings, such as 
+// input iterators or iterators yielding temporaries, are copied first.
 template <typename C>
-void RadixTree<C>::_dump(const Node& n, size_t level, C& s) const {
-  for(auto &[k,v]: n.children){
-    s.append(level, '-').append(1, ' ');
-    s += k;
-    s.append(1, '\n');
-    _dump(*v, level+1, s);
+template <typename I>
+RadixTree<C>::RadixTree(I first, I last, const allocator_type& alloc) : _alloc(alloc) {
+  if constexpr(_stable_range<I>){
+    _load(first, last);
+  }
+  else{
+    const std::vector<C> words(first, last);
+    _load(words.begin(), words.end());
   }
 }
 
-// Procedure: _match_prefix 
-// Find all words that match the given prefix 
+// Procedure: _load
+// Bulk-load a range of lasting strings into an empty tree
 template <typename C>
-void RadixTree<C>::_match_prefix(
-  std::vector<C> &vec, 
-  const Node& n, 
-  const C& s
-) const {
-  if(n.is_word){
-    vec.emplace_back(s);
-  }
-  for(auto& [k,v]:n.children){
-    _match_prefix(vec, *v, s+k);
+template <typename I>
+void RadixTree<C>::_load(I first, I last){
+  std::vector<std::basic_string_view<value_type, traits_type>> words(first, last);
+  if(not std::is_sorted(words.begin(), words.end())){
+    std::sort(words.begin(), words.end());
   }
+  _insert_sorted(words);
 }
 
-// Procedure: all_words 
-// Extract all words in the radix tree 
+// Procedure: Ctor 
+// Build the tree from a range of words on the given number of threads. Words are 
+// partitioned by their first code unit, since each partition becomes exactly one edge of 
+// the root. Workers take partitions from the largest down, sort and bulk-load each into 
+// its own tree, and the root edges are stitched under the root in order of first code unit. 
+// The result is identical to the sequential build. Ranges are copied first as above. 
+// Workers allocate from the tree's allocator at the same time, so the build runs on one 
+// thread unless the allocator is known to be thread-safe: a stateless allocator, or a pmr 
+// allocator over new_delete_resource or a synchronized_pool_resource.
 template <typename C>
-std::vector<C> RadixTree<C>::all_words() const {
-  std::vector<C> words;
-  for(auto &[k, v]: _root.children){
-    _match_prefix(words, *v, k);
+template <typename I>
+RadixTree<C>::RadixTree(I first, I last, size_t num_threads, const allocator_type& alloc) : 
+  _alloc(alloc) {
+  if constexpr(_stable_range<I>){
+    _load(first, last, num_threads);
+  }
+  else{
+    const std::vector<C> words(first, last);
+    _load(words.begin(), words.end(), num_threads);
   }
-  return words;
 }
 
-// Procedure: match_prefix 
-// Collect all words that match the given prefix 
+// Procedure: _load
+// Bulk-load a range of lasting strings into an empty tree on the given number of threads
 template <typename C>
-std::vector<C> RadixTree<C>::match_prefix(const C& prefix) const {
+template <typename I>
+void RadixTree<C>::_load(I first, I last, size_t num_threads){
+
+  using view_type = std::basic_string_view<value_type, traits_type>;
+
+  if(not _concurrent_allocation()){
+    num_threads = 1;
+  }
+
+  std::vector<std::vector<view_type>> parts;
+  {
+    std::unordered_map<value_type, size_t> index;
+    for(; first != last; ++first){
+      if(view_type w {*first}; not w.empty()){
+        auto [itr, ok] = index.try_emplace(w[0], parts.size());
+        if(ok){
+          parts.emplace_back();
+        }
+        parts[itr->second].push_back(w);
+      }
+    }
+  }
+
+  std::vector<size_t> order(parts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ 
+    return parts[a].size() > parts[b].size(); 
+  });
+
+  std::vector<RadixTree> trees;
+  trees.reserve(parts.size());
+  for(size_t i=0; i<parts.size(); ++i){
+    trees.emplace_back(_alloc);
+  }
+  std::atomic<size_t> next {0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&](){
+    try{
+      for(size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < order.size(); ){
+        auto& words = parts[order[i]];
+        if(not std::is_sorted(words.begin(), words.end())){
+          std::sort(words.begin(), words.end());
+        }
+        trees[order[i]]._insert_sorted(words);
+      }
+    }
+    catch(...){
+      std::scoped_lock lock(error_mutex);
+      error = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(size_t t=1; t<std::min(num_threads, parts.size()); ++t){
+    threads.emplace_back(worker);
+  }
+  worker();
+  for(auto& t: threads){
+    t.join();
+  }
+  if(error){
+    std::rethrow_exception(error);
+  }
+
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ 
+    return traits_type::lt(parts[a][0][0], parts[b][0][0]); 
+  });
+  for(auto i: order){
+    auto& [label, child] = *trees[i]._root.children.begin();
+    _root.num_words += child->num_words;
+    _root.children.emplace_back(std::move(label), std::move(child));
+  }
+}
+
+// Function: _concurrent_allocation
+// Return whether several threads may allocate from the tree's allocator at once
+template <typename C>
+bool RadixTree<C>::_concurrent_allocation() const {
+  if constexpr(std::allocator_traits<allocator_type>::is_always_equal::value){
+    return true;
+  }
+  else if constexpr(std::is_same_v<allocator_type, std::pmr::polymorphic_allocator<value_type>>){
+    auto r = _alloc.resource();
+    return r == std::pmr::new_delete_resource() or 
+           dynamic_cast<std::pmr::synchronized_pool_resource*>(r) != nullptr;
+  }
+  else{
+    return false;
+  }
+}
+
+// Function: _make_node
+// Allocate an empty node whose child table uses the tree's allocator
+template <typename C>
+typename RadixTree<C>::node_pointer RadixTree<C>::_make_node(){
+  using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<Node>;
+  using node_traits = std::allocator_traits<node_allocator>;
+  node_allocator alloc(_alloc);
+  Node* node = node_traits::allocate(alloc, 1);
+  try{
+    node_traits::construct(alloc, node, _alloc);
+  }
+  catch(...){
+    node_traits::deallocate(alloc, node, 1);
+    throw;
+  }
+  return node_pointer(node);
+}
+
+// Procedure: operator()
+// Destroy a node and release its memory with the allocator of its child table
+template <typename C>
+void RadixTree<C>::NodeDeleter::operator()(Node* node) const {
+  using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<Node>;
+  using node_traits = std::allocator_traits<node_allocator>;
+  node_allocator alloc(node->children.get_allocator());
+  node_traits::destroy(alloc, node);
+  node_traits::deallocate(alloc, node, 1);
+}
+
+// Procedure: _insert_sorted
+// Build the tree from sorted words in O(total characters) without splitting edges. The 
+// stack holds the open nodes on the path to the previous word. For each word, the nodes 
+// deeper than its longest common prefix with the previous word are complete: they are 
+// popped and attached to their parents, which now know the edge labels. A new branching 
+// node is opened when the common prefix ends inside an edge.
+template <typename C>
+void RadixTree<C>::_insert_sorted(
+  const std::vector<std::basic_string_view<value_type, traits_type>>& words
+){
+  
+  struct Open {
+    Node* node;
+    node_pointer owner;            // null for the root
+    size_t depth;                  // number of code units from the root
+    std::basic_string_view<value_type, traits_type> word;  // any word through the node
+  };
+
+  std::vector<Open> stack;
+  stack.push_back({&_root, nullptr, 0, {}});
+
+  // Pop every node deeper than the given depth and attach it to its parent
+  auto close = [&](size_t depth){
+    std::optional<Open> last;
+    while(stack.back().depth > depth){
+      auto top = std::move(stack.back());
+      stack.pop_back();
+      if(last){
+        top.node->num_words += last->node->num_words;
+        top.node->children.emplace_back(
+          C(last->word.substr(top.depth, last->depth - top.depth), _alloc), std::move(last->owner)
+        );
+      }
+      last = std::move(top);
+    }
+    if(last){
+      if(stack.back().depth < depth){
+        auto node = _make_node();
+        auto ptr = node.get();
+        stack.push_back({ptr, std::move(node), depth, last->word});
+      }
+      auto& par = stack.back();
+      par.node->num_words += last->node->num_words;
+      par.node->children.emplace_back(
+        C(last->word.substr(par.depth, last->depth - par.depth), _alloc), std::move(last->owner)
+      );
+    }
+  };
+
+  std::basic_string_view<value_type, traits_type> prev;
+  for(const auto& w: words){
+    if(w.empty()){  // Empty string not allowed
+      continue;
+    }
+    const auto lcp = count_prefix<C>(prev, w);
+    if(lcp == w.size()){  // Duplicate
+      continue;
+    }
+    close(lcp);
+    auto node = _make_node();
+    auto ptr = node.get();
+    ptr->is_word = true;
+    ptr->num_words = 1;
+    stack.push_back({ptr, std::move(node), w.size(), w});
+    prev = w;
+  }
+  close(0);
+}
+
+
+// Procedure: dump 
+// Dump the radix tree into a string 
+template <typename C>
+C RadixTree<C>::dump() const {
+  C t;
+  _dump(_root, 0, t);      
+  t.append(1, '\n');
+  return t;
+}
+
+// Procedure: _dump 
+// Recursively traverse the tree and append each level to string 
+template <typename C>
+void RadixTree<C>::_dump(const Node& n, size_t level, C& s) const {
+  for(auto &[k,v]: n.children){
+    s.append(level, '-').append(1, ' ');
+    s += k;
+    s.append(1, '\n');
+    _dump(*v, level+1, s);
+  }
+}
+
+// Procedure: dump 
+// Write the same text as dump() to a stream one edge at a time, without building the string
+template <typename C>
+void RadixTree<C>::dump(std::basic_ostream<value_type, traits_type>& os) const {
+  _dump(_root, 0, os);
+  os.put('\n');
+}
+
+// Procedure: _dump 
+// Recursively traverse the tree and write each level to the stream
+template <typename C>
+void RadixTree<C>::_dump(
+  const Node& n, size_t level, std::basic_ostream<value_type, traits_type>& os
+) const {
+  for(auto &[k,v]: n.children){
+    for(size_t i=0; i<level; ++i){
+      os.put('-');
+    }
+    os.put(' ');
+    os.write(k.data(), k.size());
+    os.put('\n');
+    _dump(*v, level+1, os);
+  }
+}
+
+// Function: stats
+// Collect the shape and memory summary of the tree in one traversal. Heap bytes are an 
+// estimate: the size of every node, its child table and every label stored outside the 
+// string object, without allocator overhead.
+template <typename C>
+RadixTreeStats RadixTree<C>::stats() const {
+  RadixTreeStats stats;
+  _stats(_root, 0, stats);
+  stats.heap_bytes += stats.label_bytes;
+  stats.heap_bytes -= sizeof(Node);   // the root lives inside the tree
+  size_t total_depth {0};
+  for(size_t d=0; d<stats.depth_histogram.size(); ++d){
+    total_depth += d * stats.depth_histogram[d];
+  }
+  if(stats.num_words > 0){
+    stats.average_word_depth = static_cast<double>(total_depth) / stats.num_words;
+  }
+  return stats;
+}
+
+// Procedure: _stats
+// Recursively add a node and its subtree to the stats
+template <typename C>
+void RadixTree<C>::_stats(const Node& n, size_t depth, RadixTreeStats& stats) const {
+  ++stats.num_nodes;
+  stats.heap_bytes += sizeof(Node) + n.children.heap_bytes();
+  stats.max_depth = std::max(stats.max_depth, depth);
+  if(n.is_word){
+    ++stats.num_words;
+    if(stats.depth_histogram.size() <= depth){
+      stats.depth_histogram.resize(depth+1);
+    }
+    ++stats.depth_histogram[depth];
+  }
+  if(stats.fanout_histogram.size() <= n.children.size()){
+    stats.fanout_histogram.resize(n.children.size()+1);
+  }
+  ++stats.fanout_histogram[n.children.size()];
+  for(const auto& [k, v]: n.children){
+    stats.label_code_units += k.size();
+    // A label in the small-string buffer points into the string object itself
+    const auto data = reinterpret_cast<uintptr_t>(k.data());
+    const auto self = reinterpret_cast<uintptr_t>(&k);
+    if(data < self or data >= self + sizeof(k)){
+      stats.label_bytes += (k.capacity() + 1) * sizeof(value_type);
+    }
+    _stats(*v, depth+1, stats);
+  }
+}
+
+// Function: for_each_prefix
+// Visit every word that matches the given prefix. The visitor receives a view into one 
+// scratch buffer that is reused across words, so the view is only valid during the call. 
+// A visitor returning bool can stop the traversal early by returning false. The function
+// returns false if the traversal was stopped and true otherwise.
+template <typename C>
+template <typename V>
+bool RadixTree<C>::for_each_prefix(
+  std::basic_string_view<value_type, traits_type> prefix, 
+  V&& visitor
+) const {
   if(auto [prefix_node, suffix] = _search_prefix_node(prefix); prefix_node == nullptr){
-    return {};
+    return true;
   }
   else{
-    std::vector<C> matches;
-    if(prefix_node->is_word){
-      matches.emplace_back(prefix + suffix);
+    C s;
+    s.reserve(prefix.size() + suffix.size() + 32);
+    s.append(prefix.data(), prefix.size()).append(suffix.data(), suffix.size());
+    return _for_each_prefix(*prefix_node, s, visitor);
+  }
+}
+
+// Function: _for_each_prefix
+// Recursively visit the words under a node. The buffer holds the word spelled by the path 
+// to the node and is restored before returning.
+template <typename C>
+template <typename V>
+bool RadixTree<C>::_for_each_prefix(const Node& n, C& s, V& visitor) const {
+  if(n.is_word){
+    std::basic_string_view<value_type, traits_type> word {s};
+    if constexpr(std::is_same_v<std::invoke_result_t<V&, decltype(word)>, bool>){
+      if(not visitor(word)){
+        return false;
+      }
+    }
+    else{
+      visitor(word);
+    }
+  }
+  for(auto& [k,v]:n.children){
+    const auto len = s.size();
+    s += k;
+    if(not _for_each_prefix(*v, s, visitor)){
+      return false;
     }
-    for(auto &[k, v]: prefix_node->children){
-      _match_prefix(matches, *v, prefix+suffix+k);
+    s.resize(len);
+  }
+  return true;
+}
+
+// Procedure: all_words 
+// Extract all words in the radix tree 
+template <typename C>
+std::vector<C> RadixTree<C>::all_words() const {
+  std::vector<C> words;
+  for_each_prefix({}, [&](auto w){ words.emplace_back(w); });
+  return words;
+}
+
+// Procedure: match_prefix 
+// Collect all words that match the given prefix 
+template <typename C>
+std::vector<C> RadixTree<C>::match_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  std::vector<C> matches;
+  for_each_prefix(prefix, [&](auto w){ matches.emplace_back(w); });
+  return matches;
+}
+
+// Procedure: match_prefix 
+// Collect one page of the words that match the given prefix: skip the first offset words 
+// and return at most limit words, in the order of the full match. Subtrees that fall 
+// entirely before the page are skipped by their word counts, so the cost is O(depth) plus 
+// the size of the page.
+template <typename C>
+std::vector<C> RadixTree<C>::match_prefix(
+  std::basic_string_view<value_type, traits_type> prefix, size_t offset, size_t limit
+) const {
+  std::vector<C> matches;
+  if(auto [prefix_node, suffix] = _search_prefix_node(prefix); 
+     prefix_node != nullptr and offset < prefix_node->num_words and limit > 0){
+    C s {prefix};
+    s.append(suffix.data(), suffix.size());
+    matches.reserve(std::min(limit, prefix_node->num_words - offset));
+    _match_prefix(*prefix_node, s, offset, limit, matches);
+  }
+  return matches;
+}
+
+// Procedure: _match_prefix 
+// Collect the page of words under a node. Offset and limit are consumed as words are 
+// skipped and collected.
+template <typename C>
+void RadixTree<C>::_match_prefix(
+  const Node& n, C& s, size_t& offset, size_t& limit, std::vector<C>& matches
+) const {
+  if(n.is_word){
+    if(offset > 0){
+      --offset;
+    }
+    else{
+      matches.push_back(s);
+      --limit;
+    }
+  }
+  for(auto itr = n.children.begin(); itr != n.children.end() and limit > 0; ++itr){
+    const auto& [k, v] = *itr;
+    if(offset >= v->num_words){
+      offset -= v->num_words;
+      continue;
     }
-    return matches;
+    const auto len = s.size();
+    s += k;
+    _match_prefix(*v, s, offset, limit, matches);
+    s.resize(len);
   }
 }
 
-// Procedure: _search_prefix_node 
-// Find the node that matches the given prefix 
+// Function: count_prefix_matches
+// Return the number of words that match the given prefix in O(depth)
 template <typename C>
-std::pair<const typename RadixTree<C>::Node*, C> RadixTree<C>::_search_prefix_node(
-  std::basic_string_view<value_type, traits_type> s
+size_t RadixTree<C>::count_prefix_matches(
+  std::basic_string_view<value_type, traits_type> prefix
 ) const {
+  auto prefix_node = _search_prefix_node(prefix).first;
+  return prefix_node == nullptr ? 0 : prefix_node->num_words;
+}
 
-  Node const *n = &_root;
-  std::basic_string<value_type, traits_type> suffix;
-  for(size_t pos=0; pos<s.size(); ){ // Search until full match
-    bool match = {false};
+// Procedure: _search_folded
+// Visit every node at which a path equal to the prefix under the folding policy F ends. 
+// Several edges of a node may start with code units that fold alike, so each of them is 
+// followed. The visitor receives the node and the number of code units left on its edge 
+// beyond the prefix. If a buffer is given it holds the original spelling of the path, 
+// through the whole last edge, during each visit.
+template <typename C>
+template <typename F, typename V>
+void RadixTree<C>::_search_folded(
+  const Node& n, std::basic_string_view<value_type, traits_type> rest, C* path, V& visitor
+) const {
+  if(rest.empty()){
+    visitor(n, size_t{0});
+    return;
+  }
+  auto follow = [&](const auto& k, const auto& v){
+    const auto num = count_prefix<C, F>(k, rest);
+    if(num < rest.size() and num < k.size()){  // Mismatch in the middle of the edge
+      return;
+    }
+    const auto len = path ? path->size() : 0;
+    if(path){
+      path->append(k);
+    }
+    if(num == rest.size()){
+      visitor(*v, k.size() - num);
+    }
+    else{
+      _search_folded<F>(*v, rest.substr(num), path, visitor);
+    }
+    if(path){
+      path->resize(len);
+    }
+  };
+  // Look up each spelling of the first code unit, or scan the edges if F cannot list them
+  if constexpr(F::template enumerable<value_type>){
+    const auto heads = F::variants(rest[0]);
+    for(size_t i=0; i<heads.size(); ++i){
+      if(std::find(heads.begin(), heads.begin() + i, heads[i]) != heads.begin() + i){
+        continue;
+      }
+      if(auto itr = n.children.find(heads[i]); itr != n.children.end()){
+        follow(itr->first, itr->second);
+      }
+    }
+  }
+  else{
+    const auto head = F::fold(rest[0]);
+    for(const auto& [k, v]: n.children){
+      if(F::fold(k[0]) == head){
+        follow(k, v);
+      }
+    }
+  }
+}
+
+// Function: exist
+// Check whether a word equal to the given one under the folding policy F is in the tree
+template <typename C>
+template <typename F>
+bool RadixTree<C>::exist(std::basic_string_view<value_type, traits_type> s) const {
+  bool found {false};
+  auto visitor = [&](const Node& n, size_t left){ found = found or (left == 0 and n.is_word); };
+  if(not s.empty()){
+    _search_folded<F>(_root, s, nullptr, visitor);
+  }
+  return found;
+}
+
+// Function: count_prefix_matches
+// Return the number of words that match the given prefix under the folding policy F
+template <typename C>
+template <typename F>
+size_t RadixTree<C>::count_prefix_matches(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  size_t num {0};
+  auto visitor = [&](const Node& n, size_t){ num += n.num_words; };
+  _search_folded<F>(_root, prefix, nullptr, visitor);
+  return num;
+}
+
+// Procedure: match_prefix 
+// Collect all words that match the given prefix under the folding policy F, spelled as 
+// they were inserted. Only the result buffer is allocated; nothing is folded into a copy.
+template <typename C>
+template <typename F>
+std::vector<C> RadixTree<C>::match_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  std::vector<C> matches;
+  C s;
+  auto collect = [&](auto w){ matches.emplace_back(w); };
+  auto visitor = [&](const Node& n, size_t){ _for_each_prefix(n, s, collect); };
+  _search_folded<F>(_root, prefix, &s, visitor);
+  return matches;
+}
+
+// Procedure: match_prefix 
+// Collect one page of the words that match the given prefix under the folding policy F 
+// (see the unfolded overload). Subtrees before the page are skipped by their word counts.
+template <typename C>
+template <typename F>
+std::vector<C> RadixTree<C>::match_prefix(
+  std::basic_string_view<value_type, traits_type> prefix, size_t offset, size_t limit
+) const {
+  std::vector<C> matches;
+  C s;
+  auto visitor = [&](const Node& n, size_t){ 
+    if(offset >= n.num_words){
+      offset -= n.num_words;
+    }
+    else if(limit > 0){
+      _match_prefix(n, s, offset, limit, matches);
+    }
+  };
+  _search_folded<F>(_root, prefix, &s, visitor);
+  return matches;
+}
+
+// Function: common_prefix
+// Return the longest prefix, as spelled in the tree, of every word that matches the given 
+// prefix under the folding policy F, or nullopt if no word matches. Below each node where 
+// the prefix ends, the words share the path down to the first node that ends a word or 
+// branches, so it costs O(depth) per spelling of the prefix whatever the number of matches.
+template <typename C>
+template <typename F>
+std::optional<C> RadixTree<C>::common_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  std::optional<C> common;
+  C s;
+  auto visitor = [&](const Node& n, size_t){
+    if(n.num_words == 0){
+      return;
+    }
+    const auto len = s.size();
+    auto p = &n;
+    while(not p->is_word and p->children.size() == 1){
+      const auto& [k, v] = *p->children.begin();
+      s += k;
+      p = v.get();
+    }
+    if(not common){
+      common = s;
+    }
+    else{
+      common->resize(count_prefix<C>(*common, s));
+    }
+    s.resize(len);
+  };
+  _search_folded<F>(_root, prefix, &s, visitor);
+  return common;
+}
+
+// Function: resolve_unique
+// Return the word an abbreviation stands for, or nullopt if no word or more than one word 
+// starts with it. The walk follows the only populated edge below the prefix, so it costs 
+// O(depth).
+template <typename C>
+std::optional<C> RadixTree<C>::resolve_unique(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  auto [n, suffix] = _search_prefix_node(prefix);
+  if(n == nullptr or n->num_words != 1){
+    return std::nullopt;
+  }
+  C word {prefix};
+  word.append(suffix.data(), suffix.size());
+  while(not n->is_word){
     for(const auto& [k, v]: n->children){
-      if(auto num = count_prefix<C>(k, s.data()+pos); num>0){
-        pos += num;
-        if(pos == s.size()){
-          suffix = k.substr(num, k.size()-num);
-        }
+      if(v->num_words > 0){
+        word += k;
         n = v.get();
-        match = true;
         break;
       }
     }
-    if(not match){
-      return {nullptr, suffix};
-    }
   }
-  return {n, suffix};
+  return word;
+}
+
+// Procedure: _search_prefix_node 
+// Find the node that matches the given prefix (see search_prefix_node)
+template <typename C>
+std::pair<const typename RadixTree<C>::Node*, std::basic_string_view<typename C::value_type, typename C::traits_type>> 
+RadixTree<C>::_search_prefix_node(
+  std::basic_string_view<value_type, traits_type> s
+) const {
+  return search_prefix_node<C>(_root, s);
 }
 
 // Procedure: exist 
@@ -275,94 +1578,2445 @@ bool RadixTree<C>::exist(std::basic_string_view<value_type, traits_type> s) cons
 
   size_t pos {0};
   Node const *n = &_root;
-  while(not n->children.empty()){ // Search until reaching the leaf
-    bool match {false};
-    for(const auto& [k, v]: n->children){
-      auto match_num = count_prefix<C>(k, s.data()+pos);
-      if(match_num > 0){
-        if(pos += match_num; pos == s.size()){
-          if(match_num == k.size() and v->is_word){
-            return true;
-          }
-        }
-        else{
-          n = v.get();
-          match = true;
-        }
-        break;
-      }
+  while(pos < s.size()){ // Search until reaching the leaf
+    auto itr = n->children.find(s[pos]);
+    if(itr == n->children.end()){
+      return false;
     }
-    if(not match){
+    const auto& [k, v] = *itr;
+    if(count_prefix<C>(k, s.substr(pos)) != k.size()){
       return false;
     }
+    pos += k.size();
+    n = v.get();
   }
-  return false;
+  return pos > 0 and n->is_word;
+}
+
+// Procedure: insert 
+// Insert a word into radix tree 
+template <typename C>
+void RadixTree<C>::insert(const C& s){
+  if(s.empty()){  // Empty string not allowed
+    return;
+  }
+  _insert(s, _root, std::nullopt);
+}
+
+// Procedure: insert 
+// Insert a word with the given weight into radix tree. Inserting an existing word 
+// replaces its weight.
+template <typename C>
+void RadixTree<C>::insert(const C& s, size_t weight){
+  if(s.empty()){  // Empty string not allowed
+    return;
+  }
+  _insert(s, _root, weight);
+}
+
+// Procedure: _insert 
+// Insert a word into radix tree. A word inserted without weight keeps its old weight 
+// or gets zero. Returns whether the word is new and whether its weight decreased: a new 
+// word bumps the word counts along the path, and a decreased weight makes the aggregates 
+// along the path be recomputed on the way back.
+template <typename C>
+std::pair<bool, bool> RadixTree<C>::_insert(
+  std::basic_string_view<value_type, traits_type> sv, 
+  Node& n, 
+  std::optional<size_t> weight
+){
+
+  // base case
+  if(sv.empty()) {
+    const bool added = not n.is_word;
+    const bool lowered = n.is_word and weight and *weight < n.weight;
+    n.is_word = true;
+    if(weight){
+      n.weight = *weight;
+    }
+    if(lowered){
+      _update_aggregates(n);
+    }
+    else{
+      n.max_weight = std::max(n.max_weight, n.weight);
+      n.num_words += added;
+    }
+    return {added, lowered};
+  }
+
+  n.max_weight = std::max(n.max_weight, weight.value_or(0));
+
+  auto itr = n.children.find(sv[0]);
+  size_t match_num {sv.size()};
+
+  if(itr == n.children.end()){   // Base case 1 
+    n.children.emplace_back(C(sv, _alloc), _make_node());
+    itr = std::prev(n.children.end());
+  }
+  else if(match_num = count_prefix<C>(itr->first, sv); match_num < itr->first.size()) {
+    // Split the edge in place: the new parent keeps the slot (and the first code unit) 
+    // of the old edge and takes the old child under the remaining label
+    auto par = _make_node();
+    par->max_weight = itr->second->max_weight;
+    par->num_words = itr->second->num_words;
+    split_edge(*itr, match_num, std::move(par));
+  }
+
+  auto [added, lowered] = _insert(sv.substr(match_num), *itr->second, weight);
+  if(lowered){
+    _update_aggregates(n);
+  }
+  else{
+    n.num_words += added;
+  }
+  return {added, lowered};
+}
+
+// Procedure: _update_aggregates
+// Recompute the maximum word weight and the word count of a subtree from its word and 
+// its children
+template <typename C>
+void RadixTree<C>::_update_aggregates(Node& n){
+  n.max_weight = n.is_word ? n.weight : 0;
+  n.num_words = n.is_word;
+  for(const auto& [k, v]: n.children){
+    n.max_weight = std::max(n.max_weight, v->max_weight);
+    n.num_words += v->num_words;
+  }
+}
+
+// Function: erase
+// Remove a word from the radix tree. Returns false if the word is not in the tree.
+template <typename C>
+bool RadixTree<C>::erase(std::basic_string_view<value_type, traits_type> s){
+  return not s.empty() and _erase(s, _root);
+}
+
+// Function: erase_prefix
+// Remove all words that start with the given prefix. Returns false if no word matches.
+template <typename C>
+bool RadixTree<C>::erase_prefix(std::basic_string_view<value_type, traits_type> s){
+  if(s.empty()){
+    const bool erased = not _root.children.empty();
+    _root = Node(_alloc);
+    return erased;
+  }
+  return _erase_prefix(s, _root);
+}
+
+// Function: _erase
+// Remove a word under the given node and restore the radix invariant on the way back
+template <typename C>
+bool RadixTree<C>::_erase(std::basic_string_view<value_type, traits_type> sv, Node& n){
+
+  auto itr = n.children.find(sv[0]);
+  if(itr == n.children.end()){
+    return false;
+  }
+
+  auto& [k, v] = *itr;
+  if(count_prefix<C>(k, sv) != k.size()){
+    return false;
+  }
+
+  if(k.size() == sv.size()){
+    if(not v->is_word){
+      return false;
+    }
+    v->is_word = false;
+    v->weight = 0;
+    _update_aggregates(*v);
+  }
+  else if(not _erase(sv.substr(k.size()), *v)){
+    return false;
+  }
+
+  _compact(n, itr);
+  _update_aggregates(n);
+  return true;
+}
+
+// Function: _erase_prefix
+// Remove the edge on which the prefix ends together with its subtree, and restore the 
+// radix invariant on the way back
+template <typename C>
+bool RadixTree<C>::_erase_prefix(std::basic_string_view<value_type, traits_type> sv, Node& n){
+
+  auto itr = n.children.find(sv[0]);
+  if(itr == n.children.end()){
+    return false;
+  }
+
+  auto& [k, v] = *itr;
+  const auto match_num = count_prefix<C>(k, sv);
+
+  if(match_num == sv.size()){
+    n.children.erase(itr);
+  }
+  else if(match_num == k.size() and _erase_prefix(sv.substr(match_num), *v)){
+    _compact(n, itr);
+  }
+  else{
+    return false;
+  }
+
+  _update_aggregates(n);
+  return true;
+}
+
+// Procedure: _compact
+// Drop or merge the child behind the given edge after a removal (see compact_edge)
+template <typename C>
+void RadixTree<C>::_compact(Node& n, typename RadixChildren<C, Node, node_pointer>::iterator itr){
+  compact_edge(n, itr, [](const Node& v){ return v.is_word; });
+}
+
+// Function: common_extension
+// Return the longest string that every word matching the prefix continues it with, or 
+// nullopt if no word matches. The extension is the path from the prefix to the first node 
+// that ends a word or branches, so it costs O(depth) whatever the number of matches.
+template <typename C>
+std::optional<C> RadixTree<C>::common_extension(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  auto [n, suffix] = _search_prefix_node(prefix);
+  if(n == nullptr or n->num_words == 0){  // No match, or an empty prefix of an empty tree
+    return std::nullopt;
+  }
+  C ext(suffix);
+  while(not n->is_word and n->children.size() == 1){
+    const auto& [k, v] = *n->children.begin();
+    ext += k;
+    n = v.get();
+  }
+  return ext;
+}
+
+// Function: match_fuzzy
+// Return the words within the given Levenshtein distance of the query, closest first. 
+// The tree is walked alongside the dynamic programming table of the edit distance: each 
+// code unit on an edge adds one row computed from the row above it, and a subtree is 
+// pruned as soon as the minimum of its row exceeds the limit, since no extension of the 
+// path can get closer.
+template <typename C>
+std::vector<C> RadixTree<C>::match_fuzzy(
+  std::basic_string_view<value_type, traits_type> query, 
+  size_t max_edits
+) const {
+
+  // Row 0: distance from the empty path to each prefix of the query
+  std::vector<size_t> rows(query.size() + 1);
+  std::iota(rows.begin(), rows.end(), 0);
+
+  C s;
+  std::vector<std::pair<size_t, C>> matches;
+  _match_fuzzy(_root, query, max_edits, s, rows, matches);
+
+  std::stable_sort(matches.begin(), matches.end(), [](const auto& a, const auto& b){
+    return a.first < b.first;
+  });
+
+  std::vector<C> words;
+  words.reserve(matches.size());
+  for(auto& m: matches){
+    words.emplace_back(std::move(m.second));
+  }
+  return words;
+}
+
+// Procedure: _match_fuzzy
+// Recursively extend the distance table along the edges under a node. The table holds one 
+// row of query.size()+1 entries per code unit of the path and is restored before returning.
+template <typename C>
+void RadixTree<C>::_match_fuzzy(
+  const Node& n, 
+  std::basic_string_view<value_type, traits_type> query, 
+  size_t max_edits, 
+  C& s, 
+  std::vector<size_t>& rows, 
+  std::vector<std::pair<size_t, C>>& matches
+) const {
+
+  const size_t width {query.size() + 1};
+
+  for(const auto& [k, v]: n.children){
+
+    const size_t len {s.size()};
+    bool pruned {false};
+
+    for(const auto c: k){
+      s.push_back(c);
+      rows.resize(rows.size() + width);
+      const size_t* prev = rows.data() + rows.size() - 2*width;
+      size_t* curr = rows.data() + rows.size() - width;
+      curr[0] = prev[0] + 1;
+      size_t row_min {curr[0]};
+      for(size_t j=1; j<width; ++j){
+        curr[j] = std::min({prev[j] + 1, curr[j-1] + 1, prev[j-1] + (query[j-1] != c)});
+        row_min = std::min(row_min, curr[j]);
+      }
+      if(row_min > max_edits){
+        pruned = true;
+        break;
+      }
+    }
+
+    if(not pruned){
+      if(const auto d = rows.back(); v->is_word and d <= max_edits){
+        matches.emplace_back(d, s);
+      }
+      _match_fuzzy(*v, query, max_edits, s, rows, matches);
+    }
+
+    s.resize(len);
+    rows.resize((len + 1) * width);
+  }
+}
+
+// Function: top_k
+// Return the k heaviest words that match the given prefix in decreasing order of weight. 
+// The search is best-first on the maximum subtree weight. An expanded node sorts its 
+// children by that weight and queues only the heaviest; each child queues its next 
+// sibling when it is popped, so the queue grows by O(1) per pop instead of the fan-out.
+template <typename C>
+std::vector<C> RadixTree<C>::top_k(const C& prefix, size_t k) const {
+
+  auto [prefix_node, suffix] = _search_prefix_node(prefix);
+  if(prefix_node == nullptr or k == 0){
+    return {};
+  }
+
+  // Children of the expanded nodes, each node's run sorted by decreasing subtree weight
+  struct Child {
+    const C* label;
+    const Node* node;
+  };
+
+  // Every queued node remembers its parent and edge to spell its word on output, and the 
+  // rest [next, last) of its sibling run in children
+  struct Entry {
+    const Node* node;
+    const C* label;
+    size_t parent;
+    size_t next;
+    size_t last;
+  };
+
+  // A queue item is a node to expand or, when is_word is set, a word to output. At equal 
+  // priority words come first and earlier entries come first.
+  struct Item {
+    size_t priority;
+    bool is_word;
+    size_t entry;
+    bool operator < (const Item& rhs) const {
+      return std::tie(priority, is_word, rhs.entry) < std::tie(rhs.priority, rhs.is_word, entry);
+    }
+  };
+
+  std::vector<Child> children;
+  std::vector<Entry> entries {{prefix_node, nullptr, 0, 0, 0}};
+  std::priority_queue<Item> queue;
+  queue.push({prefix_node->max_weight, false, 0});
+
+  // Queue the child at children[i] of the given parent entry
+  auto push_child = [&](size_t i, size_t last, size_t parent){
+    entries.push_back({children[i].node, children[i].label, parent, i+1, last});
+    queue.push({children[i].node->max_weight, false, entries.size()-1});
+  };
+
+  std::vector<C> words;
+  std::vector<const C*> labels;
+
+  while(not queue.empty() and words.size() < k){
+    const auto item = queue.top();
+    queue.pop();
+
+    if(item.is_word){
+      labels.clear();
+      for(auto e=item.entry; e!=0; e=entries[e].parent){
+        labels.push_back(entries[e].label);
+      }
+      auto& w = words.emplace_back(prefix);
+      w.append(suffix.data(), suffix.size());
+      for(auto itr=labels.rbegin(); itr!=labels.rend(); ++itr){
+        w += **itr;
+      }
+      continue;
+    }
+
+    // The next sibling is no heavier than this node, so it can wait until now
+    if(const auto e = entries[item.entry]; e.next < e.last){
+      push_child(e.next, e.last, e.parent);
+    }
+
+    const auto& n = *entries[item.entry].node;
+    if(n.is_word){
+      queue.push({n.weight, true, item.entry});
+    }
+    if(n.children.size() > 0){
+      const size_t first {children.size()};
+      for(const auto& [label, child]: n.children){
+        children.push_back({&label, child.get()});
+      }
+      std::sort(children.begin() + first, children.end(), [](const Child& a, const Child& b){
+        return a.node->max_weight > b.node->max_weight;
+      });
+      push_child(first, children.size(), item.entry);
+    }
+  }
+  return words;
+}
+
+
+// Procedure: root
+// Return the root of RadixTree 
+template <typename C>
+const typename RadixTree<C>::Node& RadixTree<C>::root() const{
+  return _root;
+}
+
+// Function: freeze
+// Build an immutable succinct copy of the tree (see FrozenRadixTree)
+template <typename C>
+FrozenRadixTree<C> RadixTree<C>::freeze() const {
+  return FrozenRadixTree<C>(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: RadixMap
+// A radix tree that maps each word to a value. It uses the same child tables and subtree 
+// word counts as RadixTree, so an exact lookup, a prefix lookup and the expansion of a 
+// unique abbreviation each take one traversal and hand out a pointer into the node that 
+// stores the value.
+template <typename C, typename V>
+class RadixMap{
+
+  using value_type     = typename C::value_type;
+  using traits_type    = typename C::traits_type;
+  using allocator_type = typename C::allocator_type;
+
+  public:
+
+    struct Node {
+      std::optional<V> value;   // value of the word ending at this node
+      size_t num_words {0};     // number of words in this subtree
+      RadixChildren<C, Node> children;
+    };
+
+   std::pair<V*, bool> insert(std::basic_string_view<value_type, traits_type>, V);
+   bool erase(std::basic_string_view<value_type, traits_type>);
+
+   V* find(std::basic_string_view<value_type, traits_type>);
+   const V* find(std::basic_string_view<value_type, traits_type>) const;
+
+   std::vector<std::pair<C, V*>> find_prefix(std::basic_string_view<value_type, traits_type>);
+   std::vector<std::pair<C, const V*>> find_prefix(
+     std::basic_string_view<value_type, traits_type>
+   ) const;
+
+   V* resolve_unique(std::basic_string_view<value_type, traits_type>);
+   const V* resolve_unique(std::basic_string_view<value_type, traits_type>) const;
+
+   size_t size() const { return _root.num_words; }
+   bool empty() const { return _root.num_words == 0; }
+
+  private:
+
+   Node _root;
+
+   bool _erase(std::basic_string_view<value_type, traits_type>, Node&);
+
+   // Accessors shared by the const and mutable overloads; M is the map with its constness
+   template <typename M>
+   using _value_pointer = std::conditional_t<std::is_const_v<M>, const V*, V*>;
+
+   template <typename M>
+   static auto _find(M&, std::basic_string_view<value_type, traits_type>) -> _value_pointer<M>;
+
+   template <typename M>
+   static auto _find_prefix(M&, std::basic_string_view<value_type, traits_type>)
+     -> std::vector<std::pair<C, _value_pointer<M>>>;
+
+   template <typename N, typename P>
+   static void _find_prefix(N&, C&, std::vector<std::pair<C, P>>&);
+
+   template <typename M>
+   static auto _resolve_unique(M&, std::basic_string_view<value_type, traits_type>) 
+     -> _value_pointer<M>;
+};
+
+// Function: insert
+// Insert a word with its value, or replace the value of an existing word. Returns the 
+// stored value and whether the word is new.
+template <typename C, typename V>
+std::pair<V*, bool> RadixMap<C, V>::insert(
+  std::basic_string_view<value_type, traits_type> s, 
+  V value
+){
+  if(s.empty()){  // Empty string not allowed
+    return {nullptr, false};
+  }
+
+  std::vector<Node*> path {&_root};
+  for(size_t pos=0; pos<s.size(); ){
+    auto& n = *path.back();
+    auto itr = n.children.find(s[pos]);
+    if(itr == n.children.end()){
+      auto& edge = n.children.emplace_back(C(s.substr(pos)), std::make_unique<Node>());
+      path.push_back(edge.second.get());
+      break;
+    }
+    const auto match_num = count_prefix<C>(itr->first, s.substr(pos));
+    if(match_num < itr->first.size()){
+      auto par = std::make_unique<Node>();
+      par->num_words = itr->second->num_words;
+      split_edge(*itr, match_num, std::move(par));
+    }
+    pos += match_num;
+    path.push_back(itr->second.get());
+  }
+
+  auto& leaf = *path.back();
+  const bool added = not leaf.value.has_value();
+  leaf.value = std::move(value);
+  if(added){
+    for(auto n: path){
+      ++n->num_words;
+    }
+  }
+  return {&*leaf.value, added};
+}
+
+// Function: erase
+// Remove a word and its value. Returns false if the word is not in the map.
+template <typename C, typename V>
+bool RadixMap<C, V>::erase(std::basic_string_view<value_type, traits_type> s){
+  return not s.empty() and _erase(s, _root);
+}
+
+// Function: _erase
+// Remove a word under the given node, then drop or merge the child on the path
+template <typename C, typename V>
+bool RadixMap<C, V>::_erase(std::basic_string_view<value_type, traits_type> sv, Node& n){
+
+  auto itr = n.children.find(sv[0]);
+  if(itr == n.children.end()){
+    return false;
+  }
+
+  auto& [k, v] = *itr;
+  if(count_prefix<C>(k, sv) != k.size()){
+    return false;
+  }
+
+  if(k.size() == sv.size()){
+    if(not v->value){
+      return false;
+    }
+    v->value.reset();
+    --v->num_words;
+  }
+  else if(not _erase(sv.substr(k.size()), *v)){
+    return false;
+  }
+  --n.num_words;
+
+  compact_edge(n, itr, [](const Node& c){ return c.value.has_value(); });
+  return true;
+}
+
+// Function: _find
+// Return the value of the given word, or nullptr if the word is not in the map
+template <typename C, typename V>
+template <typename M>
+auto RadixMap<C, V>::_find(M& map, std::basic_string_view<value_type, traits_type> s) 
+  -> _value_pointer<M> {
+  if(auto [n, suffix] = search_prefix_node<C>(map._root, s); n != nullptr and suffix.empty() and n->value){
+    return &*n->value;
+  }
+  return nullptr;
+}
+
+// Function: find
+// Return the value of the given word, or nullptr if the word is not in the map
+template <typename C, typename V>
+const V* RadixMap<C, V>::find(std::basic_string_view<value_type, traits_type> s) const {
+  return _find(*this, s);
+}
+
+// Function: find
+// Mutable overload of find
+template <typename C, typename V>
+V* RadixMap<C, V>::find(std::basic_string_view<value_type, traits_type> s){
+  return _find(*this, s);
+}
+
+// Function: _find_prefix
+// Return every word that starts with the given prefix together with its value, in the 
+// order RadixTree::match_prefix lists words
+template <typename C, typename V>
+template <typename M>
+auto RadixMap<C, V>::_find_prefix(M& map, std::basic_string_view<value_type, traits_type> prefix)
+  -> std::vector<std::pair<C, _value_pointer<M>>> {
+  std::vector<std::pair<C, _value_pointer<M>>> matches;
+  if(auto [n, suffix] = search_prefix_node<C>(map._root, prefix); n != nullptr){
+    C s {prefix};
+    s.append(suffix.data(), suffix.size());
+    matches.reserve(n->num_words);
+    _find_prefix(*n, s, matches);
+  }
+  return matches;
+}
+
+// Function: find_prefix
+// Return every word that starts with the given prefix together with its value
+template <typename C, typename V>
+std::vector<std::pair<C, const V*>> RadixMap<C, V>::find_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  return _find_prefix(*this, prefix);
+}
+
+// Function: find_prefix
+// Mutable overload of find_prefix
+template <typename C, typename V>
+std::vector<std::pair<C, V*>> RadixMap<C, V>::find_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+){
+  return _find_prefix(*this, prefix);
+}
+
+// Procedure: _find_prefix
+// Recursively collect the words and values under a node
+template <typename C, typename V>
+template <typename N, typename P>
+void RadixMap<C, V>::_find_prefix(N& n, C& s, std::vector<std::pair<C, P>>& matches){
+  if(n.value){
+    matches.emplace_back(s, &*n.value);
+  }
+  for(auto& [k, v]: n.children){
+    const auto len = s.size();
+    s += k;
+    _find_prefix(*v, s, matches);
+    s.resize(len);
+  }
+}
+
+// Function: _resolve_unique
+// Return the value of the only word that starts with the given abbreviation, or nullptr if 
+// no word or more than one word does. An exact word is its own abbreviation only when no 
+// other word extends it.
+template <typename C, typename V>
+template <typename M>
+auto RadixMap<C, V>::_resolve_unique(M& map, std::basic_string_view<value_type, traits_type> prefix)
+  -> _value_pointer<M> {
+  auto n = search_prefix_node<C>(map._root, prefix).first;
+  if(n == nullptr or n->num_words != 1){
+    return nullptr;
+  }
+  while(not n->value){
+    for(auto& [k, v]: n->children){
+      if(v->num_words > 0){
+        n = v.get();
+        break;
+      }
+    }
+  }
+  return &*n->value;
+}
+
+// Function: resolve_unique
+// Return the value of the only word that starts with the given abbreviation
+template <typename C, typename V>
+const V* RadixMap<C, V>::resolve_unique(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  return _resolve_unique(*this, prefix);
+}
+
+// Function: resolve_unique
+// Mutable overload of resolve_unique
+template <typename C, typename V>
+V* RadixMap<C, V>::resolve_unique(std::basic_string_view<value_type, traits_type> prefix){
+  return _resolve_unique(*this, prefix);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: FlatRadixTree
+// A radix tree whose nodes live in one contiguous arena. Each node refers to its first child, 
+// its next sibling and its edge label by 32-bit index, and all edge labels share one label pool.
+// Splitting an edge only adjusts label offsets, so the pool grows by the new suffix only. 
+// Children are kept in insertion order as in RadixTree, so both trees list words alike. A 
+// node with more children than RadixChildren scans linearly gets a side table of their first 
+// code units, searched with find_code_unit like the wide child tables of RadixTree.
+template <typename C>
+class FlatRadixTree{
+
+  using value_type     = typename C::value_type;
+  using traits_type    = typename C::traits_type;
+  using allocator_type = typename C::allocator_type;
+
+  public:
+
+    static constexpr uint32_t npos {std::numeric_limits<uint32_t>::max()};
+
+    struct Node {
+      uint32_t label_beg {0};           // offset of the edge label in the label pool
+      uint32_t label_len : 30;          // length of the edge label
+      uint32_t is_word   : 1;
+      uint32_t is_wide   : 1;           // children are looked up in _fanouts
+      uint32_t first_child {npos};
+      uint32_t next_sibling {npos};
+
+      Node(uint32_t b = 0, uint32_t l = 0) : label_beg {b}, label_len {l}, is_word {0}, is_wide {0} {}
+    };
+
+   FlatRadixTree();
+   FlatRadixTree(const std::vector<C>&);
+
+   bool exist(std::basic_string_view<value_type, traits_type>) const;
+   void insert(const C&);
+
+   std::vector<C> match_prefix(const C&) const;
+   std::vector<C> all_words() const;
+   C dump() const;
+
+   size_t num_nodes() const;
+   void shrink_to_fit();
+
+  private:
+
+   // First code unit and node of each child of a wide node, in sibling order
+   struct Fanout {
+     std::vector<value_type> keys;
+     std::vector<uint32_t> nodes;
+   };
+
+   static constexpr size_t _narrow_max {4};
+
+   std::vector<Node> _nodes;   // _nodes[0] is the root
+   C _labels;                  // label pool of all edges
+   std::unordered_map<uint32_t, Fanout> _fanouts;
+
+   std::basic_string_view<value_type, traits_type> _label(const Node&) const;
+
+   uint32_t _find_child(uint32_t, value_type) const;
+   uint32_t _new_node(std::basic_string_view<value_type, traits_type>);
+   void _append_child(uint32_t, uint32_t);
+   void _insert(std::basic_string_view<value_type, traits_type>);
+
+   void _match_prefix(std::vector<C>&, uint32_t, C&) const;
+   void _dump(uint32_t, size_t, C&) const;
+};
+
+// Procedure: Ctor
+template <typename C>
+FlatRadixTree<C>::FlatRadixTree(){
+  _nodes.emplace_back();
+}
+
+// Procedure: Ctor
+// Insert the words in sorted order, so the children end up in the order of a RadixTree 
+// built from the same words
+template <typename C>
+FlatRadixTree<C>::FlatRadixTree(const std::vector<C>& words) : FlatRadixTree() {
+  std::vector<std::basic_string_view<value_type, traits_type>> sorted(words.begin(), words.end());
+  std::sort(sorted.begin(), sorted.end());
+  for(const auto& w: sorted){
+    _insert(w);
+  }
+}
+
+// Function: num_nodes
+// Return the number of nodes in the arena including the root
+template <typename C>
+size_t FlatRadixTree<C>::num_nodes() const {
+  return _nodes.size();
+}
+
+// Procedure: shrink_to_fit
+// Release the spare capacity of the node arena and the label pool
+template <typename C>
+void FlatRadixTree<C>::shrink_to_fit(){
+  _nodes.shrink_to_fit();
+  _labels.shrink_to_fit();
+  for(auto& [n, f]: _fanouts){
+    f.keys.shrink_to_fit();
+    f.nodes.shrink_to_fit();
+  }
+}
+
+// Function: _label
+// Return the edge label of a node as a view into the label pool
+template <typename C>
+std::basic_string_view<typename C::value_type, typename C::traits_type> 
+FlatRadixTree<C>::_label(const Node& n) const {
+  return {_labels.data() + n.label_beg, n.label_len};
+}
+
+// Function: _find_child
+// Return the child whose edge label starts with the given code unit. By the radix 
+// invariant at most one child qualifies.
+template <typename C>
+uint32_t FlatRadixTree<C>::_find_child(uint32_t n, value_type c) const {
+  if(_nodes[n].is_wide){
+    const auto& f = _fanouts.find(n)->second;
+    const auto slot = find_code_unit(f.keys.data(), f.keys.size(), c);
+    return slot == f.keys.size() ? npos : f.nodes[slot];
+  }
+  for(auto i=_nodes[n].first_child; i!=npos; i=_nodes[i].next_sibling){
+    if(_labels[_nodes[i].label_beg] == c){
+      return i;
+    }
+  }
+  return npos;
+}
+
+// Procedure: _append_child
+// Link a node after the last child of n. A node that outgrows the linear scan gets a 
+// fan-out table of its children.
+template <typename C>
+void FlatRadixTree<C>::_append_child(uint32_t n, uint32_t child){
+  const auto key = _labels[_nodes[child].label_beg];
+  if(_nodes[n].is_wide){
+    auto& f = _fanouts.find(n)->second;
+    _nodes[f.nodes.back()].next_sibling = child;
+    f.keys.push_back(key);
+    f.nodes.push_back(child);
+    return;
+  }
+  size_t num {0};
+  auto* link = &_nodes[n].first_child;
+  for(; *link != npos; link = &_nodes[*link].next_sibling){
+    ++num;
+  }
+  *link = child;
+  if(++num > _narrow_max){
+    auto& f = _fanouts[n];
+    for(auto i=_nodes[n].first_child; i!=npos; i=_nodes[i].next_sibling){
+      f.keys.push_back(_labels[_nodes[i].label_beg]);
+      f.nodes.push_back(i);
+    }
+    _nodes[n].is_wide = 1;
+  }
+}
+
+// Function: _new_node
+// Append a node whose edge label is copied to the end of the label pool
+template <typename C>
+uint32_t FlatRadixTree<C>::_new_node(std::basic_string_view<value_type, traits_type> label){
+  if(_nodes.size() >= npos or _labels.size() + label.size() >= npos or label.size() >= (1u << 30)){
+    throw std::length_error("FlatRadixTree exceeds the 32-bit index range");
+  }
+  _nodes.emplace_back(_labels.size(), label.size());
+  _labels.append(label.data(), label.size());
+  return _nodes.size() - 1;
+}
+
+// Procedure: insert 
+// Insert a word into radix tree 
+template <typename C>
+void FlatRadixTree<C>::insert(const C& s){
+  _insert(s);
+}
+
+// Procedure: _insert 
+// Insert a word; a new child is appended after its siblings
+template <typename C>
+void FlatRadixTree<C>::_insert(std::basic_string_view<value_type, traits_type> sv){
+  if(sv.empty()){  // Empty string not allowed
+    return;
+  }
+
+  uint32_t n {0};
+  for(size_t pos=0; pos<sv.size(); ){
+
+    // Base case 1: no child shares the first code unit, append a new leaf
+    auto c = _find_child(n, sv[pos]);
+    if(c == npos){
+      auto leaf = _new_node(sv.substr(pos));
+      _nodes[leaf].is_word = 1;
+      _append_child(n, leaf);
+      return;
+    }
+
+    auto match_num = count_prefix<C>(_label(_nodes[c]), sv.substr(pos));
+
+    // Split the edge at the mismatch: the new middle node takes over the slot of c 
+    // in the sibling list and c keeps the remaining part of its label
+    if(match_num < _nodes[c].label_len){
+      auto mid = _new_node({});
+      _nodes[mid].label_beg = _nodes[c].label_beg;
+      _nodes[mid].label_len = match_num;
+      _nodes[mid].first_child = c;
+      _nodes[mid].next_sibling = _nodes[c].next_sibling;
+      _nodes[c].label_beg += match_num;
+      _nodes[c].label_len -= match_num;
+      _nodes[c].next_sibling = npos;
+
+      // The sibling before c comes from the fan-out table of a wide node and from a walk 
+      // of the short sibling list otherwise
+      auto prev = npos;
+      if(_nodes[n].is_wide){
+        auto& f = _fanouts.find(n)->second;
+        const auto slot = find_code_unit(f.keys.data(), f.keys.size(), sv[pos]);
+        f.nodes[slot] = mid;
+        prev = slot == 0 ? npos : f.nodes[slot-1];
+      }
+      else if(_nodes[n].first_child != c){
+        for(prev = _nodes[n].first_child; _nodes[prev].next_sibling != c; prev = _nodes[prev].next_sibling);
+      }
+      (prev == npos ? _nodes[n].first_child : _nodes[prev].next_sibling) = mid;
+      c = mid;
+    }
+
+    pos += match_num;
+    n = c;
+  }
+
+  _nodes[n].is_word = 1;
+}
+
+// Procedure: exist 
+// Check whether the given word is in the radix tree or not 
+template <typename C>
+bool FlatRadixTree<C>::exist(std::basic_string_view<value_type, traits_type> s) const {
+  if(s.empty()){
+    return false;
+  }
+  uint32_t n {0};
+  for(size_t pos=0; pos<s.size(); ){
+    auto c = _find_child(n, s[pos]);
+    if(c == npos){
+      return false;
+    }
+    const auto label = _label(_nodes[c]);
+    if(count_prefix<C>(label, s.substr(pos)) != label.size()){
+      return false;
+    }
+    pos += label.size();
+    n = c;
+  }
+  return _nodes[n].is_word;
+}
+
+// Procedure: _match_prefix 
+// Find all words under a node. The buffer holds the word spelled by the path to the node.
+template <typename C>
+void FlatRadixTree<C>::_match_prefix(std::vector<C>& vec, uint32_t n, C& s) const {
+  if(_nodes[n].is_word){
+    vec.emplace_back(s);
+  }
+  for(auto c=_nodes[n].first_child; c!=npos; c=_nodes[c].next_sibling){
+    const auto len = s.size();
+    s.append(_labels, _nodes[c].label_beg, _nodes[c].label_len);
+    _match_prefix(vec, c, s);
+    s.resize(len);
+  }
+}
+
+// Procedure: all_words 
+// Extract all words in the radix tree 
+template <typename C>
+std::vector<C> FlatRadixTree<C>::all_words() const {
+  std::vector<C> words;
+  C s;
+  _match_prefix(words, 0, s);
+  return words;
+}
+
+// Procedure: match_prefix 
+// Collect all words that match the given prefix 
+template <typename C>
+std::vector<C> FlatRadixTree<C>::match_prefix(const C& prefix) const {
+
+  uint32_t n {0};
+  C s {prefix};
+
+  for(size_t pos=0; pos<prefix.size(); ){
+    auto c = _find_child(n, prefix[pos]);
+    if(c == npos){
+      return {};
+    }
+    const auto label = _label(_nodes[c]);
+    const auto num = count_prefix<C>(label, std::basic_string_view<value_type, traits_type>{prefix}.substr(pos));
+    if(pos += num; pos == prefix.size()){
+      // The prefix may end in the middle of the edge
+      s.append(label.data() + num, label.size() - num);
+    }
+    else if(num != label.size()){
+      return {};
+    }
+    n = c;
+  }
+
+  std::vector<C> matches;
+  _match_prefix(matches, n, s);
+  return matches;
+}
+
+// Procedure: dump 
+// Dump the radix tree into a string 
+template <typename C>
+C FlatRadixTree<C>::dump() const {
+  C t;
+  _dump(0, 0, t);      
+  t.append(1, '\n');
+  return t;
+}
+
+// Procedure: _dump 
+// Recursively traverse the tree and append each level to string 
+template <typename C>
+void FlatRadixTree<C>::_dump(uint32_t n, size_t level, C& s) const {
+  for(auto c=_nodes[n].first_child; c!=npos; c=_nodes[c].next_sibling){
+    s.append(level, '-').append(1, ' ');
+    s.append(_labels, _nodes[c].label_beg, _nodes[c].label_len);
+    s.append(1, '\n');
+    _dump(c, level+1, s);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: FrozenRadixTree
+// An immutable succinct radix tree built by RadixTree::freeze. Nodes are numbered in 
+// breadth-first order and the topology is a LOUDS bit vector: the root is preceded by "10" 
+// and each node appends one 1-bit per child followed by a 0-bit. Children of a node get 
+// consecutive numbers and are sorted by their first code unit, and the edge labels are 
+// concatenated into one blob in node order. All sections live in one image of 64-bit words 
+// and refer to each other by offset, so the image can be saved to a file and mapped back 
+// with mmap, and queries run directly on the mapped pages.
+template <typename C>
+class FrozenRadixTree{
+
+  using value_type  = typename C::value_type;
+  using traits_type = typename C::traits_type;
+  using view_type   = std::basic_string_view<value_type, traits_type>;
+
+  public:
+
+   FrozenRadixTree();
+   explicit FrozenRadixTree(const RadixTree<C>&);
+
+   bool exist(view_type) const;
+
+   std::vector<C> match_prefix(const C&) const;
+   std::vector<C> all_words() const;
+
+   template <typename V>
+   bool for_each_prefix(view_type, V&&) const;
+
+   size_t num_nodes() const;
+   size_t num_bytes() const;
+
+   void save(const std::filesystem::path&) const;
+   static FrozenRadixTree open(const std::filesystem::path&);
+
+  private:
+
+   static constexpr uint64_t _magic {0x58445254504d5250};  // "PRMPTRDX" in little endian
+   static constexpr uint32_t _version {1};
+
+   // Section offsets are in 64-bit words from the start of the image
+   struct Header {
+     uint64_t magic;
+     uint32_t version;
+     uint32_t code_unit;       // sizeof(value_type)
+     uint64_t image_words;     // size of the image in 64-bit words
+     uint64_t num_nodes;
+     uint64_t louds_bits;
+     uint64_t louds;           // LOUDS bits
+     uint64_t louds_rank;      // 32-bit count of 1-bits before each 512-bit block
+     uint64_t words;           // one bit per node marking the end of a word
+     uint64_t label_offsets;   // 32-bit offset of each node's label, plus the end offset
+     uint64_t labels;          // concatenated edge labels
+   };
+
+   static constexpr size_t _block_words {8};
+
+   std::shared_ptr<const uint64_t> _image;   // owned buffer or mapped file
+
+   FrozenRadixTree(std::shared_ptr<const uint64_t>);
+
+   static bool _valid_payload(const uint64_t*);
+
+   const Header& _header() const;
+   const uint64_t* _louds() const;
+   const uint32_t* _louds_rank() const;
+   const uint64_t* _words() const;
+   const uint32_t* _label_offsets() const;
+   const value_type* _labels() const;
+
+   size_t _select0(size_t) const;
+   std::pair<size_t, size_t> _children(size_t) const;
+   size_t _find_child(size_t, value_type) const;
+   view_type _label(size_t) const;
+   bool _is_word(size_t) const;
+
+   template <typename V>
+   bool _for_each_prefix(size_t, C&, V&) const;
+};
+
+// Procedure: Ctor
+// Build an image with the root only
+template <typename C>
+FrozenRadixTree<C>::FrozenRadixTree() : FrozenRadixTree(RadixTree<C>{}) {
+}
+
+// Procedure: Ctor
+// Build the succinct image from a radix tree in one breadth-first pass
+template <typename C>
+FrozenRadixTree<C>::FrozenRadixTree(const RadixTree<C>& tree){
+
+  using Node = typename RadixTree<C>::Node;
+
+  std::vector<const Node*> nodes {&tree.root()};
+  std::vector<uint64_t> louds;
+  size_t louds_bits {0};
+  std::vector<uint32_t> label_offsets {0, 0};
+  C labels;
+
+  auto push_bit = [&](bool b){
+    if(louds_bits % 64 == 0){
+      louds.push_back(0);
+    }
+    if(b){
+      louds.back() |= uint64_t{1} << (louds_bits % 64);
+    }
+    ++louds_bits;
+  };
+
+  push_bit(true);
+  push_bit(false);
+
+  std::vector<std::pair<const C*, const Node*>> children;
+  for(size_t i=0; i<nodes.size(); ++i){
+    children.clear();
+    for(const auto& [k, v]: nodes[i]->children){
+      children.emplace_back(&k, v.get());
+    }
+    std::sort(children.begin(), children.end(), [](const auto& a, const auto& b){
+      return (*a.first)[0] < (*b.first)[0];
+    });
+    for(const auto& [k, v]: children){
+      push_bit(true);
+      nodes.push_back(v);
+      labels += *k;
+      if(labels.size() >= std::numeric_limits<uint32_t>::max()){
+        throw std::length_error("FrozenRadixTree exceeds the 32-bit label range");
+      }
+      label_offsets.push_back(labels.size());
+    }
+    push_bit(false);
+  }
+
+  // Lay out the sections
+  const size_t num_blocks {(louds.size() + _block_words - 1) / _block_words + 1};
+  Header h;
+  h.magic         = _magic;
+  h.version       = _version;
+  h.code_unit     = sizeof(value_type);
+  h.num_nodes     = nodes.size();
+  h.louds_bits    = louds_bits;
+  h.louds         = (sizeof(Header) + 7) / 8;
+  h.louds_rank    = h.louds + louds.size();
+  h.words         = h.louds_rank + (num_blocks + 1) / 2;
+  h.label_offsets = h.words + (nodes.size() + 63) / 64;
+  h.labels        = h.label_offsets + (label_offsets.size() + 1) / 2;
+
+  h.image_words   = h.labels + (labels.size() * sizeof(value_type) + 7) / 8;
+
+  uint64_t* image = new uint64_t[h.image_words]();
+  _image.reset(image, std::default_delete<uint64_t[]>());
+
+  std::memcpy(image, &h, sizeof(h));
+  std::memcpy(image + h.louds, louds.data(), louds.size() * 8);
+
+  auto rank = reinterpret_cast<uint32_t*>(image + h.louds_rank);
+  for(size_t b=1; b<num_blocks; ++b){
+    rank[b] = rank[b-1];
+    for(size_t w=(b-1)*_block_words; w<std::min(b*_block_words, louds.size()); ++w){
+      rank[b] += __builtin_popcountll(louds[w]);
+    }
+  }
+
+  for(size_t i=0; i<nodes.size(); ++i){
+    if(nodes[i]->is_word){
+      image[h.words + i/64] |= uint64_t{1} << (i % 64);
+    }
+  }
+
+  std::memcpy(image + h.label_offsets, label_offsets.data(), label_offsets.size() * 4);
+  std::memcpy(image + h.labels, labels.data(), labels.size() * sizeof(value_type));
+}
+
+// Procedure: Ctor
+// Adopt an image that has been validated by the caller
+template <typename C>
+FrozenRadixTree<C>::FrozenRadixTree(std::shared_ptr<const uint64_t> image) : 
+  _image {std::move(image)} {
+}
+
+// Procedure: save
+// Write the image to a file that can be opened later by FrozenRadixTree::open
+template <typename C>
+void FrozenRadixTree<C>::save(const std::filesystem::path& path) const {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if(not ofs.write(reinterpret_cast<const char*>(_image.get()), num_bytes()) or 
+     not ofs.flush()){
+    throw std::runtime_error("failed to save radix tree image to " + path.string());
+  }
+}
+
+// Function: open
+// Map an image file saved by FrozenRadixTree::save into memory. Nothing is deserialized: 
+// queries read the mapped pages, and processes mapping the same file share them through 
+// the page cache. The mapping is released with the last copy of the tree.
+template <typename C>
+FrozenRadixTree<C> FrozenRadixTree<C>::open(const std::filesystem::path& path) {
+
+  auto fail = [&](const char* what) {
+    return std::runtime_error(std::string(what) + ": " + path.string());
+  };
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd == -1){
+    throw fail("failed to open radix tree image");
+  }
+
+  struct stat st;
+  if(::fstat(fd, &st) == -1 or static_cast<size_t>(st.st_size) < sizeof(Header) or 
+     st.st_size % sizeof(uint64_t) != 0){
+    ::close(fd);
+    throw fail("invalid radix tree image size");
+  }
+
+  const size_t size = st.st_size;
+  void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(addr == MAP_FAILED){
+    throw fail("failed to map radix tree image");
+  }
+
+  std::shared_ptr<const uint64_t> image(static_cast<const uint64_t*>(addr), [size](const uint64_t* p){
+    ::munmap(const_cast<uint64_t*>(p), size);
+  });
+
+  const auto& h = *reinterpret_cast<const Header*>(image.get());
+  const size_t words {size / sizeof(uint64_t)};
+  if(h.magic != _magic){
+    throw fail("not a radix tree image");
+  }
+  if(h.version != _version){
+    throw fail("unsupported radix tree image version");
+  }
+  if(h.code_unit != sizeof(value_type)){
+    throw fail("radix tree image has a different code unit width");
+  }
+  if(h.image_words != words or h.louds > h.louds_rank or h.louds_rank > h.words or 
+     h.words > h.label_offsets or h.label_offsets > h.labels or h.labels > words or
+     h.louds_bits > (h.louds_rank - h.louds) * 64 or h.num_nodes > (h.label_offsets - h.words) * 64 or
+     h.num_nodes + 1 > (h.labels - h.label_offsets) * 2 or not _valid_payload(image.get())){
+    throw fail("corrupted radix tree image");
+  }
+
+  return FrozenRadixTree(std::move(image));
+}
+
+// Function: _valid_payload
+// Check in one pass over the sections that the queries stay within the image, given a 
+// header whose section bounds have been checked. The LOUDS must have the "10" root 
+// prefix, one 1-bit per node and one more 0-bit, and number every child after its parent 
+// so that traversals end. The rank directory must match the LOUDS, and the label offsets 
+// must start with the empty root label, grow strictly and end within the label section.
+template <typename C>
+bool FrozenRadixTree<C>::_valid_payload(const uint64_t* image){
+
+  const auto& h = *reinterpret_cast<const Header*>(image);
+  const size_t n {h.num_nodes};
+  if(n == 0 or h.louds_bits != 2 * n + 1){
+    return false;
+  }
+
+  // LOUDS shape: the i-th 0-bit closes node i-1's children (the first one the root prefix)
+  const uint64_t* louds {image + h.louds};
+  const size_t louds_words {(h.louds_bits + 63) / 64};
+  const size_t num_blocks {(louds_words + _block_words - 1) / _block_words + 1};
+  if(num_blocks > (h.words - h.louds_rank) * 2){
+    return false;
+  }
+  if((louds[0] & 3) != 1){
+    return false;
+  }
+  size_t ones {0}, zeros {0};
+  for(size_t q=0; q<h.louds_bits; ++q){
+    if((louds[q/64] >> (q % 64)) & 1){
+      if(ones < zeros){  // node ones is a child of node zeros-1
+        return false;
+      }
+      ++ones;
+    }
+    else{
+      ++zeros;
+    }
+  }
+  if(ones != n or zeros != n + 1 or ((louds[(h.louds_bits-1)/64] >> ((h.louds_bits-1) % 64)) & 1)){
+    return false;
+  }
+
+  // Rank directory
+  const auto rank = reinterpret_cast<const uint32_t*>(image + h.louds_rank);
+  uint64_t count {0};
+  for(size_t b=0; b<num_blocks; ++b){
+    if(rank[b] != count){
+      return false;
+    }
+    for(size_t w=b*_block_words; w<std::min((b+1)*_block_words, louds_words); ++w){
+      count += __builtin_popcountll(louds[w]);
+    }
+  }
+
+  // Label offsets
+  const auto offsets = reinterpret_cast<const uint32_t*>(image + h.label_offsets);
+  const size_t num_labels {(h.image_words - h.labels) * 8 / sizeof(value_type)};
+  if(offsets[0] != 0 or offsets[1] != 0 or offsets[n] > num_labels){
+    return false;
+  }
+  for(size_t i=1; i<n; ++i){
+    if(offsets[i+1] <= offsets[i]){
+      return false;
+    }
+  }
+  return true;
+}
+
+// Function: _header
+template <typename C>
+const typename FrozenRadixTree<C>::Header& FrozenRadixTree<C>::_header() const {
+  return *reinterpret_cast<const Header*>(_image.get());
+}
+
+// Function: _louds
+template <typename C>
+const uint64_t* FrozenRadixTree<C>::_louds() const {
+  return _image.get() + _header().louds;
+}
+
+// Function: _louds_rank
+template <typename C>
+const uint32_t* FrozenRadixTree<C>::_louds_rank() const {
+  return reinterpret_cast<const uint32_t*>(_image.get() + _header().louds_rank);
+}
+
+// Function: _words
+template <typename C>
+const uint64_t* FrozenRadixTree<C>::_words() const {
+  return _image.get() + _header().words;
+}
+
+// Function: _label_offsets
+template <typename C>
+const uint32_t* FrozenRadixTree<C>::_label_offsets() const {
+  return reinterpret_cast<const uint32_t*>(_image.get() + _header().label_offsets);
+}
+
+// Function: _labels
+template <typename C>
+const typename C::value_type* FrozenRadixTree<C>::_labels() const {
+  return reinterpret_cast<const value_type*>(_image.get() + _header().labels);
+}
+
+// Function: num_nodes
+// Return the number of nodes including the root
+template <typename C>
+size_t FrozenRadixTree<C>::num_nodes() const {
+  return _header().num_nodes;
+}
+
+// Function: num_bytes
+// Return the size of the image in bytes
+template <typename C>
+size_t FrozenRadixTree<C>::num_bytes() const {
+  return _header().image_words * sizeof(uint64_t);
+}
+
+// Function: _select0
+// Return the position of the k-th (0-based) 0-bit of the LOUDS. The rank directory 
+// locates the 512-bit block and popcounts locate the word.
+template <typename C>
+size_t FrozenRadixTree<C>::_select0(size_t k) const {
+
+  const auto louds = _louds();
+  const auto rank  = _louds_rank();
+  const size_t block_bits {_block_words * 64};
+  const size_t louds_words {(_header().louds_bits + 63) / 64};
+
+  // Find the last block that starts with at most k 0-bits before it
+  size_t lo {0}, hi {(louds_words + _block_words - 1) / _block_words};
+  while(hi - lo > 1){
+    const size_t mid {(lo + hi) / 2};
+    if(mid * block_bits - rank[mid] <= k){
+      lo = mid;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  k -= lo * block_bits - rank[lo];
+
+  for(size_t w=lo*_block_words; ; ++w){
+    uint64_t z = ~louds[w];
+    if(const size_t c = __builtin_popcountll(z); k >= c){
+      k -= c;
+      continue;
+    }
+    for(; k>0; --k){
+      z &= z - 1;
+    }
+    return w * 64 + __builtin_ctzll(z);
+  }
+}
+
+// Function: _children
+// Return the first child and the number of children of a node
+template <typename C>
+std::pair<size_t, size_t> FrozenRadixTree<C>::_children(size_t i) const {
+  const auto louds = _louds();
+  const size_t p {_select0(i)};
+  size_t num {0};
+  for(size_t q=p+1; ; ){
+    const size_t avail {64 - q % 64};
+    const uint64_t zeros {~(louds[q/64] >> (q % 64))};
+    const size_t ones {zeros ? std::min<size_t>(__builtin_ctzll(zeros), avail) : avail};
+    num += ones;
+    if(ones < avail){
+      break;
+    }
+    q += ones;
+  }
+  return {p - i, num};
+}
+
+// Function: _label
+// Return the label of the edge into a node
+template <typename C>
+typename FrozenRadixTree<C>::view_type FrozenRadixTree<C>::_label(size_t i) const {
+  const auto offsets = _label_offsets();
+  return {_labels() + offsets[i], offsets[i+1] - offsets[i]};
+}
+
+// Function: _is_word
+template <typename C>
+bool FrozenRadixTree<C>::_is_word(size_t i) const {
+  return (_words()[i/64] >> (i % 64)) & 1;
+}
+
+// Function: _find_child
+// Binary search the sorted children for the one whose label starts with the code unit
+template <typename C>
+size_t FrozenRadixTree<C>::_find_child(size_t i, value_type c) const {
+  const auto [first, num] = _children(i);
+  const auto offsets = _label_offsets();
+  const auto labels  = _labels();
+  size_t lo {first}, hi {first + num};
+  while(lo < hi){
+    const size_t mid {(lo + hi) / 2};
+    if(labels[offsets[mid]] < c){
+      lo = mid + 1;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  return (lo < first + num and labels[offsets[lo]] == c) ? lo : num_nodes();
+}
+
+// Procedure: exist 
+// Check whether the given word is in the radix tree or not 
+template <typename C>
+bool FrozenRadixTree<C>::exist(view_type s) const {
+  size_t n {0};
+  for(size_t pos=0; pos<s.size(); ){
+    if(n = _find_child(n, s[pos]); n == num_nodes()){
+      return false;
+    }
+    const auto label = _label(n);
+    if(count_prefix<C>(label, s.substr(pos)) != label.size()){
+      return false;
+    }
+    pos += label.size();
+  }
+  return n != 0 and _is_word(n);
+}
+
+// Function: for_each_prefix
+// Visit every word that matches the given prefix (see RadixTree::for_each_prefix)
+template <typename C>
+template <typename V>
+bool FrozenRadixTree<C>::for_each_prefix(view_type prefix, V&& visitor) const {
+  size_t n {0};
+  C s;
+  s.reserve(prefix.size() + 32);
+  s.append(prefix.data(), prefix.size());
+  for(size_t pos=0; pos<prefix.size(); ){
+    if(n = _find_child(n, prefix[pos]); n == num_nodes()){
+      return true;
+    }
+    const auto label = _label(n);
+    const auto num = count_prefix<C>(label, prefix.substr(pos));
+    if(pos += num; pos == prefix.size()){
+      s.append(label.data() + num, label.size() - num);
+    }
+    else if(num != label.size()){
+      return true;
+    }
+  }
+  return _for_each_prefix(n, s, visitor);
+}
+
+// Function: _for_each_prefix
+// Recursively visit the words under a node
+template <typename C>
+template <typename V>
+bool FrozenRadixTree<C>::_for_each_prefix(size_t n, C& s, V& visitor) const {
+  if(_is_word(n)){
+    view_type word {s};
+    if constexpr(std::is_same_v<std::invoke_result_t<V&, view_type>, bool>){
+      if(not visitor(word)){
+        return false;
+      }
+    }
+    else{
+      visitor(word);
+    }
+  }
+  const auto [first, num] = _children(n);
+  for(size_t c=first; c<first+num; ++c){
+    const auto len = s.size();
+    const auto label = _label(c);
+    s.append(label.data(), label.size());
+    if(not _for_each_prefix(c, s, visitor)){
+      return false;
+    }
+    s.resize(len);
+  }
+  return true;
+}
+
+// Procedure: all_words 
+// Extract all words in the radix tree 
+template <typename C>
+std::vector<C> FrozenRadixTree<C>::all_words() const {
+  std::vector<C> words;
+  for_each_prefix({}, [&](auto w){ words.emplace_back(w); });
+  return words;
+}
+
+// Procedure: match_prefix 
+// Collect all words that match the given prefix 
+template <typename C>
+std::vector<C> FrozenRadixTree<C>::match_prefix(const C& prefix) const {
+  std::vector<C> matches;
+  for_each_prefix(prefix, [&](auto w){ matches.emplace_back(w); });
+  return matches;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: ConcurrentRadixTree
+// A radix tree that can be read from any thread while another thread inserts words. It keeps 
+// two copies of the tree following the left-right scheme. Readers announce themselves on 
+// one of two counters and read the active copy: a read never blocks, retries or allocates. 
+// Writers are serialized. A writer updates the standby copy, makes it active, waits for a 
+// grace period in which every reader that may still see the old copy leaves, and then 
+// applies the same update to the old copy. No node is ever shared between readers and the 
+// writer, so nothing has to be reclaimed.
+template <typename C>
+class ConcurrentRadixTree{
+
+  using value_type     = typename C::value_type;
+  using traits_type    = typename C::traits_type;
+  using allocator_type = typename C::allocator_type;
+
+  public:
+
+   ConcurrentRadixTree() = default;
+   explicit ConcurrentRadixTree(const allocator_type&);
+
+   template <typename F>
+   auto read(F&&) const;
+
+   template <typename F>
+   void write(F&&);
+
+   bool exist(std::basic_string_view<value_type, traits_type>) const;
+   void insert(const C&);
+   void insert(const C&, size_t);
+
+   template <typename I>
+   void insert(I, I);
+
+   bool erase(std::basic_string_view<value_type, traits_type>);
+   bool erase_prefix(std::basic_string_view<value_type, traits_type>);
+
+   std::vector<C> match_prefix(std::basic_string_view<value_type, traits_type>) const;
+   std::vector<C> all_words() const;
+
+  private:
+
+   std::array<RadixTree<C>, 2> _trees;
+   std::atomic<size_t> _active {0};
+
+   std::atomic<size_t> _epoch {0};
+   mutable std::array<std::atomic<size_t>, 2> _readers {};
+
+   std::mutex _mutex;
+
+   void _synchronize();
+};
+
+// Procedure: Ctor
+// Create an empty tree whose two copies allocate with the given allocator
+template <typename C>
+ConcurrentRadixTree<C>::ConcurrentRadixTree(const allocator_type& alloc) : 
+  _trees {RadixTree<C>(alloc), RadixTree<C>(alloc)} {
+}
+
+// Function: read
+// Call f with the active copy of the tree and return its result. The reference must not 
+// escape the call.
+template <typename C>
+template <typename F>
+auto ConcurrentRadixTree<C>::read(F&& f) const {
+
+  struct Guard {
+    std::atomic<size_t>& readers;
+    ~Guard() { readers.fetch_sub(1, std::memory_order_release); }
+  };
+
+  auto& readers = _readers[_epoch.load() & 1];
+  readers.fetch_add(1);
+  Guard guard {readers};
+  return f(static_cast<const RadixTree<C>&>(_trees[_active.load()]));
+}
+
+// Procedure: write
+// Apply f to both copies of the tree. f must be deterministic so that both copies stay equal. 
+// Only the basic exception guarantee holds: if f throws on the first copy, readers keep 
+// seeing the unchanged one; if it throws on the second copy, readers see the updated one. 
+// Either way the two copies are left different, and later reads may see either of them.
+template <typename C>
+template <typename F>
+void ConcurrentRadixTree<C>::write(F&& f){
+  std::scoped_lock lock(_mutex);
+  const auto active = _active.load(std::memory_order_relaxed);
+  f(_trees[1 - active]);
+  _active.store(1 - active);
+  _synchronize();
+  f(_trees[active]);
+}
+
+// Procedure: _synchronize
+// Wait until every reader that may have picked the previous copy has left. Each round moves 
+// new readers to the other counter and drains the counter of the previous epoch, so readers 
+// keep entering while the writer waits.
+template <typename C>
+void ConcurrentRadixTree<C>::_synchronize(){
+  for(size_t round=0; round<2; ++round){
+    const auto prev = _epoch.fetch_add(1);
+    while(_readers[prev & 1].load() != 0){
+      std::this_thread::yield();
+    }
+  }
+}
+
+// Procedure: insert 
+// Insert a word into the radix tree 
+template <typename C>
+void ConcurrentRadixTree<C>::insert(const C& s){
+  write([&](RadixTree<C>& t){ t.insert(s); });
+}
+
+// Procedure: insert 
+// Insert a word with the given weight into the radix tree 
+template <typename C>
+void ConcurrentRadixTree<C>::insert(const C& s, size_t weight){
+  write([&](RadixTree<C>& t){ t.insert(s, weight); });
+}
+
+// Procedure: insert 
+// Insert a range of words with one grace period for the whole batch. Both copies walk the 
+// range, so a single-pass range (e.g., std::istream_iterator) is first copied into a vector.
+template <typename C>
+template <typename I>
+void ConcurrentRadixTree<C>::insert(I first, I last){
+  if constexpr(std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<I>::iterator_category>){
+    write([&](RadixTree<C>& t){ 
+      for(auto itr=first; itr!=last; ++itr){
+        t.insert(*itr); 
+      }
+    });
+  }
+  else{
+    const std::vector<C> words(first, last);
+    insert(words.begin(), words.end());
+  }
+}
+
+// Function: erase
+// Remove a word from the radix tree
+template <typename C>
+bool ConcurrentRadixTree<C>::erase(std::basic_string_view<value_type, traits_type> s){
+  bool erased {false};
+  write([&](RadixTree<C>& t){ erased = t.erase(s); });
+  return erased;
+}
+
+// Function: erase_prefix
+// Remove all words that start with the given prefix
+template <typename C>
+bool ConcurrentRadixTree<C>::erase_prefix(std::basic_string_view<value_type, traits_type> s){
+  bool erased {false};
+  write([&](RadixTree<C>& t){ erased = t.erase_prefix(s); });
+  return erased;
+}
+
+// Procedure: exist 
+// Check whether the given word is in the radix tree or not 
+template <typename C>
+bool ConcurrentRadixTree<C>::exist(std::basic_string_view<value_type, traits_type> s) const {
+  return read([&](const RadixTree<C>& t){ return t.exist(s); });
+}
+
+// Procedure: match_prefix 
+// Collect all words that match the given prefix 
+template <typename C>
+std::vector<C> ConcurrentRadixTree<C>::match_prefix(
+  std::basic_string_view<value_type, traits_type> prefix
+) const {
+  return read([&](const RadixTree<C>& t){ return t.match_prefix(prefix); });
+}
+
+// Procedure: all_words 
+// Extract all words in the radix tree 
+template <typename C>
+std::vector<C> ConcurrentRadixTree<C>::all_words() const {
+  return read([&](const RadixTree<C>& t){ return t.all_words(); });
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: WordTableView
+// Read-only view of a sorted array of distinct words, such as the table built by 
+// make_word_table. Words that share a prefix are contiguous in sorted order, so every prefix 
+// query is a binary search for the range of matches and needs no nodes at all.
+template <typename C>
+class WordTableView{
+
+  public:
+
+    using view_type = std::basic_string_view<typename C::value_type, typename C::traits_type>;
+
+    constexpr WordTableView() = default;
+    constexpr WordTableView(const view_type* words, size_t size) : _words {words}, _size {size} {}
+
+    constexpr const view_type* begin() const { return _words; }
+    constexpr const view_type* end() const { return _words + _size; }
+    constexpr size_t size() const { return _size; }
+
+    constexpr bool exist(view_type) const;
+    constexpr std::pair<size_t, size_t> prefix_range(view_type) const;
+    constexpr size_t count_prefix_matches(view_type) const;
+
+    std::vector<C> match_prefix(view_type) const;
+    std::vector<C> match_prefix(view_type, size_t, size_t) const;
+    std::optional<C> common_extension(view_type) const;
+
+    template <typename F>
+    std::vector<C> match_prefix(view_type) const;
+
+    template <typename F>
+    std::optional<C> common_prefix(view_type) const;
+
+    template <typename F, typename V>
+    void for_each_prefix(view_type, V&&) const;
+
+    std::vector<C> match_fuzzy(view_type, size_t) const;
+
+  private:
+
+    const view_type* _words {nullptr};
+    size_t _size {0};
+
+    constexpr size_t _lower_bound(view_type) const;
+};
+
+// Function: _lower_bound
+// Return the index of the first word not less than s
+template <typename C>
+constexpr size_t WordTableView<C>::_lower_bound(view_type s) const {
+  size_t lo {0}, hi {_size};
+  while(lo < hi){
+    const size_t mid = lo + (hi - lo) / 2;
+    if(_words[mid] < s){
+      lo = mid + 1;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Function: exist
+// Check whether the given word is in the table
+template <typename C>
+constexpr bool WordTableView<C>::exist(view_type s) const {
+  const size_t i = _lower_bound(s);
+  return not s.empty() and i < _size and _words[i] == s;
+}
+
+// Function: prefix_range
+// Return the half-open index range of the words that start with the given prefix
+template <typename C>
+constexpr std::pair<size_t, size_t> WordTableView<C>::prefix_range(view_type prefix) const {
+  // Among the words from the lower bound on, those starting with the prefix come first
+  const size_t beg = _lower_bound(prefix);
+  size_t lo {beg}, hi {_size};
+  while(lo < hi){
+    const size_t mid = lo + (hi - lo) / 2;
+    if(_words[mid].substr(0, prefix.size()) == prefix){
+      lo = mid + 1;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  return {beg, lo};
+}
+
+// Function: count_prefix_matches
+// Return the number of words that start with the given prefix
+template <typename C>
+constexpr size_t WordTableView<C>::count_prefix_matches(view_type prefix) const {
+  const auto [beg, end] = prefix_range(prefix);
+  return end - beg;
+}
+
+// Function: match_prefix
+// Collect all words that start with the given prefix in sorted order
+template <typename C>
+std::vector<C> WordTableView<C>::match_prefix(view_type prefix) const {
+  return match_prefix(prefix, 0, _size);
+}
+
+// Function: match_prefix
+// Collect one page of the words that start with the given prefix in sorted order
+template <typename C>
+std::vector<C> WordTableView<C>::match_prefix(view_type prefix, size_t offset, size_t limit) const {
+  const auto [beg, end] = prefix_range(prefix);
+  std::vector<C> matches;
+  for(size_t i=beg+std::min(offset, end-beg); i<end and matches.size()<limit; ++i){
+    matches.emplace_back(_words[i]);
+  }
+  return matches;
+}
+
+// Function: match_prefix
+// Collect the words that start with the given prefix under the folding policy F. Folded 
+// matches are not contiguous in sorted order, so the table is scanned.
+template <typename C>
+template <typename F>
+std::vector<C> WordTableView<C>::match_prefix(view_type prefix) const {
+  std::vector<C> matches;
+  for_each_prefix<F>(prefix, [&](view_type w){ matches.emplace_back(w); });
+  return matches;
+}
+
+// Function: common_prefix
+// Return the longest prefix, as spelled in the table, of every word that matches the given 
+// prefix under the folding policy F, or nullopt if no word matches
+template <typename C>
+template <typename F>
+std::optional<C> WordTableView<C>::common_prefix(view_type prefix) const {
+  std::optional<view_type> common;
+  for_each_prefix<F>(prefix, [&](view_type w){ 
+    common = common ? common->substr(0, count_prefix<C>(*common, w)) : w; 
+  });
+  return common ? std::optional<C>(C(*common)) : std::nullopt;
+}
+
+// Procedure: for_each_prefix
+// Visit the words that start with the given prefix under the folding policy F in sorted 
+// order. Unfolded matches are one binary-searched range; folded ones are scanned for.
+template <typename C>
+template <typename F, typename V>
+void WordTableView<C>::for_each_prefix(view_type prefix, V&& visitor) const {
+  if constexpr(std::is_same_v<F, NoFold>){
+    const auto [beg, end] = prefix_range(prefix);
+    for(size_t i=beg; i<end; ++i){
+      visitor(_words[i]);
+    }
+  }
+  else{
+    for(size_t i=0; i<_size; ++i){
+      if(_words[i].size() >= prefix.size() and count_prefix<C, F>(_words[i], prefix) == prefix.size()){
+        visitor(_words[i]);
+      }
+    }
+  }
+}
+
+// Function: match_fuzzy
+// Return the words within the given Levenshtein distance of the query, closest first 
+// (see RadixTree::match_fuzzy). The table is scanned with a banded distance per word.
+template <typename C>
+std::vector<C> WordTableView<C>::match_fuzzy(view_type query, size_t max_edits) const {
+  std::vector<std::pair<size_t, view_type>> matches;
+  for(size_t i=0; i<_size; ++i){
+    if(const auto d = edit_distance<C>(_words[i], query, max_edits); d <= max_edits){
+      matches.emplace_back(d, _words[i]);
+    }
+  }
+  std::stable_sort(matches.begin(), matches.end(), [](const auto& a, const auto& b){
+    return a.first < b.first;
+  });
+  std::vector<C> words;
+  words.reserve(matches.size());
+  for(const auto& m: matches){
+    words.emplace_back(m.second);
+  }
+  return words;
+}
+
+// Function: common_extension
+// Return the longest string that every word matching the prefix continues it with, or 
+// nullopt if no word matches. In sorted order this is what the first and the last match 
+// have in common.
+template <typename C>
+std::optional<C> WordTableView<C>::common_extension(view_type prefix) const {
+  const auto [beg, end] = prefix_range(prefix);
+  if(beg == end){
+    return std::nullopt;
+  }
+  const auto& first = _words[beg];
+  const auto& last = _words[end-1];
+  return C(first.substr(prefix.size(), count_prefix<C>(first, last) - prefix.size()));
+}
+
+// Class: StaticWordTable
+// A word table whose sorted array is built at compile time. Declared static constexpr, the 
+// array and the string literals it refers to live in read-only data and nothing is built at 
+// startup. Empty and duplicate words are dropped, so size() may be less than N.
+template <typename C, size_t N>
+class StaticWordTable{
+
+  public:
+
+    using view_type = typename WordTableView<C>::view_type;
+
+    constexpr explicit StaticWordTable(const std::array<view_type, N>&);
+
+    constexpr WordTableView<C> view() const { return {_words.data(), _size}; }
+    constexpr operator WordTableView<C>() const { return view(); }
+
+    constexpr const view_type* begin() const { return _words.data(); }
+    constexpr const view_type* end() const { return _words.data() + _size; }
+    constexpr size_t size() const { return _size; }
+
+    constexpr bool exist(view_type s) const { return view().exist(s); }
+    constexpr size_t count_prefix_matches(view_type s) const { return view().count_prefix_matches(s); }
+
+    std::vector<C> match_prefix(view_type s) const { return view().match_prefix(s); }
+    std::optional<C> common_extension(view_type s) const { return view().common_extension(s); }
+
+  private:
+
+    std::array<view_type, N> _words {};
+    size_t _size {0};
+};
+
+// Procedure: Ctor
+// Sort the words with an insertion sort, which is fine for command lists and usable in a 
+// constant expression, then compact away empty and duplicate words
+template <typename C, size_t N>
+constexpr StaticWordTable<C, N>::StaticWordTable(const std::array<view_type, N>& words){
+  for(size_t i=0; i<N; ++i){
+    auto w = words[i];
+    size_t j {i};
+    for(; j>0 and w < _words[j-1]; --j){
+      _words[j] = _words[j-1];
+    }
+    _words[j] = w;
+  }
+  for(size_t i=0; i<N; ++i){
+    if(not _words[i].empty() and (_size == 0 or _words[_size-1] != _words[i])){
+      _words[_size++] = _words[i];
+    }
+  }
+  for(size_t i=_size; i<N; ++i){
+    _words[i] = view_type{};
+  }
+}
+
+// Function: make_word_table
+// Build a static word table from string literals, e.g.
+//   static constexpr auto commands = make_word_table("read_verilog", "report_timing");
+template <typename C = std::string, typename... W>
+constexpr StaticWordTable<C, sizeof...(W)> make_word_table(const W&... words){
+  using view_type = typename StaticWordTable<C, sizeof...(W)>::view_type;
+  return StaticWordTable<C, sizeof...(W)>(std::array<view_type, sizeof...(W)>{view_type(words)...});
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: SubsequenceMatcher
+// Ranked fuzzy matching in the style of fzf: a word matches when the query is a subsequence 
+// of it, ignoring ASCII case, so "rdcl" matches "read_celllib". Words are stored back to back 
+// in one blob with a 64-bit mask of the characters they contain. A query first rejects 
+// every word whose mask misses one of its characters, then checks the subsequence, and only 
+// the survivors are scored. The score rewards matches at word boundaries and consecutive 
+// matches and penalizes gaps, and the k best words are kept in a heap.
+template <typename C>
+class SubsequenceMatcher{
+
+  using value_type  = typename C::value_type;
+  using traits_type = typename C::traits_type;
+  using view_type   = std::basic_string_view<value_type, traits_type>;
+
+  public:
+
+   SubsequenceMatcher() = default;
+   explicit SubsequenceMatcher(const RadixTree<C>&);
+
+   template <typename I>
+   SubsequenceMatcher(I, I);
+
+   void insert(view_type);
+   std::vector<C> match(view_type, size_t) const;
+
+   size_t size() const;
+
+  private:
+
+   static constexpr int _score_match {16};
+   static constexpr int _score_gap_start {-3};
+   static constexpr int _score_gap_extension {-1};
+   static constexpr int _bonus_boundary {8};
+   static constexpr int _bonus_camel {7};
+   static constexpr int _bonus_consecutive {4};
+   static constexpr int _bonus_first_multiplier {2};
+   static constexpr int _neg {std::numeric_limits<int>::min() / 2};
+
+   C _blob;
+   std::vector<uint32_t> _offsets {0};
+   std::vector<uint64_t> _masks;
+
+   // Rows of the scoring table, owned by one match call and reused across its words so 
+   // that concurrent calls share nothing
+   struct Rows {
+     std::vector<int> bonus;
+     std::vector<int> prev;
+     std::vector<int> curr;
+   };
+
+   view_type _word(size_t) const;
+
+   static value_type _fold(value_type);
+   static uint64_t _bit(value_type);
+   static uint64_t _mask(view_type);
+   static int _char_class(value_type);
+
+   static int _score(view_type, view_type, Rows&);
+};
+
+// Procedure: Ctor
+// Index every word of a radix tree
+template <typename C>
+SubsequenceMatcher<C>::SubsequenceMatcher(const RadixTree<C>& tree){
+  tree.for_each_prefix({}, [&](view_type w){ insert(w); });
+}
+
+// Procedure: Ctor
+// Index a range of words
+template <typename C>
+template <typename I>
+SubsequenceMatcher<C>::SubsequenceMatcher(I first, I last){
+  for(; first != last; ++first){
+    insert(*first);
+  }
+}
+
+// Procedure: insert
+// Append a word to the index
+template <typename C>
+void SubsequenceMatcher<C>::insert(view_type w){
+  if(_blob.size() + w.size() >= std::numeric_limits<uint32_t>::max()){
+    throw std::length_error("SubsequenceMatcher exceeds the 32-bit index range");
+  }
+  _blob.append(w.data(), w.size());
+  _offsets.push_back(_blob.size());
+  _masks.push_back(_mask(w));
+}
+
+// Function: size
+// Return the number of indexed words
+template <typename C>
+size_t SubsequenceMatcher<C>::size() const {
+  return _masks.size();
+}
+
+// Function: _word
+template <typename C>
+typename SubsequenceMatcher<C>::view_type SubsequenceMatcher<C>::_word(size_t i) const {
+  return {_blob.data() + _offsets[i], _offsets[i+1] - _offsets[i]};
+}
+
+// Function: _fold
+// Fold ASCII upper case to lower case
+template <typename C>
+typename C::value_type SubsequenceMatcher<C>::_fold(value_type c){
+  return (c >= 'A' and c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+// Function: _bit
+// Map a code unit to its bit of the character mask: letters and digits get a bit of their 
+// own and other code units share the remaining bits
+template <typename C>
+uint64_t SubsequenceMatcher<C>::_bit(value_type c){
+  c = _fold(c);
+  if(c >= 'a' and c <= 'z') return uint64_t{1} << (c - 'a');
+  if(c >= '0' and c <= '9') return uint64_t{1} << (26 + c - '0');
+  return uint64_t{1} << (36 + static_cast<std::make_unsigned_t<value_type>>(c) % 28);
+}
+
+// Function: _mask
+template <typename C>
+uint64_t SubsequenceMatcher<C>::_mask(view_type w){
+  uint64_t m {0};
+  for(auto c: w){
+    m |= _bit(c);
+  }
+  return m;
+}
+
+// Function: _char_class
+// Classify a code unit for boundary bonuses: 0 separator, 1 lower case, 2 upper case, 
+// 3 digit, 4 other
+template <typename C>
+int SubsequenceMatcher<C>::_char_class(value_type c){
+  if(c >= 'a' and c <= 'z') return 1;
+  if(c >= 'A' and c <= 'Z') return 2;
+  if(c >= '0' and c <= '9') return 3;
+  if(c == '_' or c == '-' or c == '/' or c == '.' or c == ' ' or c == ':') return 0;
+  return 4;
+}
+
+// Function: _score
+// Score the best alignment of the query as a subsequence of the word. Row i of the table 
+// holds, for each word position j, the best score of matching query[0..i] with query[i] 
+// at j. A row is built in two passes: an element-wise pass over the previous row that the 
+// compiler vectorizes, and a running-maximum pass that carries gaps forward.
+template <typename C>
+int SubsequenceMatcher<C>::_score(view_type word, view_type query, Rows& rows){
+
+  const size_t n {word.size()};
+  auto& [bonus, prev, curr] = rows;
+
+  bonus.resize(n);
+  prev.resize(n);
+  curr.resize(n);
+
+  for(size_t j=0; j<n; ++j){
+    const int prev_class = j == 0 ? 0 : _char_class(word[j-1]);
+    const int curr_class = _char_class(word[j]);
+    if(curr_class == 0) bonus[j] = 0;
+    else if(prev_class == 0) bonus[j] = _bonus_boundary;
+    else if((prev_class == 1 and curr_class == 2) or (prev_class != 3 and curr_class == 3)){
+      bonus[j] = _bonus_camel;
+    }
+    else bonus[j] = 0;
+  }
+
+  // First query character: no gap penalty before the first match
+  const auto q0 = _fold(query[0]);
+  for(size_t j=0; j<n; ++j){
+    prev[j] = _fold(word[j]) == q0 ? _score_match + bonus[j] * _bonus_first_multiplier : _neg;
+  }
+
+  for(size_t i=1; i<query.size(); ++i){
+    const auto q = _fold(query[i]);
+
+    // Pass 1: consecutive match from the diagonal
+    curr[0] = _neg;
+    for(size_t j=1; j<n; ++j){
+      const int diag = prev[j-1] + _score_match + std::max(bonus[j], _bonus_consecutive);
+      curr[j] = _fold(word[j]) == q ? diag : _neg;
+    }
+
+    // Pass 2: match after a gap, carrying the best open gap forward
+    int gap {_neg};
+    for(size_t j=2; j<n; ++j){
+      gap = std::max(gap + _score_gap_extension, prev[j-2] + _score_gap_start);
+      if(_fold(word[j]) == q){
+        curr[j] = std::max(curr[j], gap + _score_match + bonus[j]);
+      }
+    }
+    std::swap(prev, curr);
+  }
+
+  return *std::max_element(prev.begin(), prev.end());
+}
+
+// Function: match
+// Return the k best words that contain the query as a subsequence, best first. Ties go to 
+// the shorter word.
+template <typename C>
+std::vector<C> SubsequenceMatcher<C>::match(view_type query, size_t k) const {
+
+  if(query.empty() or k == 0){
+    return {};
+  }
+
+  const uint64_t qmask {_mask(query)};
+  Rows rows;
+
+  // Min-heap on (score, -length) holding the best k words seen so far
+  using Entry = std::tuple<int, long, size_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> best;
+
+  for(size_t i=0; i<_masks.size(); ++i){
+    if((_masks[i] & qmask) != qmask){
+      continue;
+    }
+
+    const auto w = _word(i);
+    size_t q {0};
+    for(size_t j=0; j<w.size() and q<query.size(); ++j){
+      q += _fold(w[j]) == _fold(query[q]);
+    }
+    if(q != query.size()){
+      continue;
+    }
+
+    Entry e {_score(w, query, rows), -static_cast<long>(w.size()), i};
+    if(best.size() < k){
+      best.push(e);
+    }
+    else if(best.top() < e){
+      best.pop();
+      best.push(e);
+    }
+  }
+
+  std::vector<C> words(best.size());
+  for(auto itr=words.rbegin(); itr!=words.rend(); ++itr){
+    itr->assign(_word(std::get<2>(best.top())));
+    best.pop();
+  }
+  return words;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: SuffixIndex
+// Substring index over a vocabulary: a suffix array of all words stored back to back in one 
+// blob. Each suffix ends where its word ends, so no separator code unit is needed and a 
+// match never spans two words. The suffixes that start with a fragment form one range of 
+// the array, found by two binary searches. Each search remembers how much of the fragment 
+// is already known to match both ends of the interval and skips that part when comparing, 
+// so a lookup costs close to O(|fragment| + log n) plus the occurrences it reports.
+template <typename C>
+class SuffixIndex{
+
+  using value_type  = typename C::value_type;
+  using traits_type = typename C::traits_type;
+  using view_type   = std::basic_string_view<value_type, traits_type>;
+
+  public:
+
+   SuffixIndex() = default;
+   explicit SuffixIndex(const RadixTree<C>&);
+
+   template <typename I>
+   SuffixIndex(I, I);
+
+   std::vector<C> match_substring(view_type) const;
+   size_t count_substring(view_type) const;
+
+   size_t size() const { return _offsets.size() - 1; }
+   size_t num_suffixes() const { return _suffixes.size(); }
+
+  private:
+
+   struct Suffix {
+     uint32_t pos;    // start of the suffix in the blob
+     uint32_t word;   // word the suffix belongs to
+   };
+
+   C _blob;
+   std::vector<uint32_t> _offsets {0};
+   std::vector<Suffix> _suffixes;
+
+   view_type _suffix(const Suffix&) const;
+   view_type _word(size_t) const;
+
+   void _insert(view_type);
+   void _build();
+
+   std::pair<size_t, size_t> _range(view_type) const;
+};
+
+// Procedure: Ctor
+// Index every word of a radix tree
+template <typename C>
+SuffixIndex<C>::SuffixIndex(const RadixTree<C>& tree){
+  tree.for_each_prefix({}, [&](view_type w){ _insert(w); });
+  _build();
 }
 
-// Procedure: insert 
-// Insert a word into radix tree 
+// Procedure: Ctor
+// Index a range of distinct words; a repeated word would be reported once per copy
 template <typename C>
-void RadixTree<C>::insert(const C& s){
-  if(s.empty()){  // Empty string not allowed
-    return;
+template <typename I>
+SuffixIndex<C>::SuffixIndex(I first, I last){
+  for(; first != last; ++first){
+    _insert(*first);
   }
-  _insert(s, _root);
+  _build();
 }
 
-// Procedure: _insert 
-// Insert a word into radix tree 
+// Procedure: _insert
+// Append a word to the blob
 template <typename C>
-void RadixTree<C>::_insert(std::basic_string_view<value_type, traits_type> sv, Node& n){
+void SuffixIndex<C>::_insert(view_type w){
+  if(_blob.size() + w.size() >= std::numeric_limits<uint32_t>::max()){
+    throw std::length_error("SuffixIndex exceeds the 32-bit index range");
+  }
+  _blob.append(w.data(), w.size());
+  _offsets.push_back(_blob.size());
+}
 
-  // base case
-  if(sv.empty()) {
-    n.is_word = true;
-    return;
+// Procedure: _build
+// Sort the suffixes of all words
+template <typename C>
+void SuffixIndex<C>::_build(){
+  _suffixes.reserve(_blob.size());
+  for(uint32_t w=0; w+1<_offsets.size(); ++w){
+    for(uint32_t p=_offsets[w]; p<_offsets[w+1]; ++p){
+      _suffixes.push_back({p, w});
+    }
   }
+  std::sort(_suffixes.begin(), _suffixes.end(), [&](const Suffix& a, const Suffix& b){
+    return _suffix(a) < _suffix(b);
+  });
+}
+
+// Function: _suffix
+template <typename C>
+typename SuffixIndex<C>::view_type SuffixIndex<C>::_suffix(const Suffix& s) const {
+  return {_blob.data() + s.pos, _offsets[s.word+1] - s.pos};
+}
 
-  size_t match_num {0};
+// Function: _word
+template <typename C>
+typename SuffixIndex<C>::view_type SuffixIndex<C>::_word(size_t i) const {
+  return {_blob.data() + _offsets[i], _offsets[i+1] - _offsets[i]};
+}
 
-  auto itr = std::find_if(n.children.begin(), n.children.end(), [&] (const auto& kv) {
-    if(match_num = count_prefix<C>(std::get<0>(kv), sv); match_num > 0) {
-      return true;
+// Function: _range
+// Return the range of suffixes that start with the fragment. The lower bound is the first 
+// suffix not less than the fragment and the upper bound the first one past it that does 
+// not start with it. lo_lcp and hi_lcp are the code units the fragment shares with the 
+// suffixes at the ends of the search interval; every suffix between them shares at least 
+// the smaller of the two, so comparisons resume from there.
+template <typename C>
+std::pair<size_t, size_t> SuffixIndex<C>::_range(view_type fragment) const {
+
+  // Compare a suffix with the fragment from offset skip; returns the sign and the common length
+  auto compare = [&](const Suffix& s, size_t skip){
+    const auto suffix = _suffix(s);
+    const size_t num = skip + count_prefix<C>(suffix.substr(skip), fragment.substr(skip));
+    if(num == fragment.size()){
+      return std::make_pair(0, num);
     }
-    else return false;
-  });
+    if(num == suffix.size() or traits_type::lt(suffix[num], fragment[num])){
+      return std::make_pair(-1, num);
+    }
+    return std::make_pair(1, num);
+  };
 
-  if(match_num == 0){   // Base case 1 
-    assert(itr == n.children.end());
-    auto& child = std::get<1>(n.children.emplace_back(std::make_pair(sv, new Node))); 
-    child->is_word = true;
+  // First suffix that is not less than the fragment (or starts with it)
+  size_t lo {0}, hi {_suffixes.size()}, lo_lcp {0}, hi_lcp {0};
+  while(lo < hi){
+    const size_t mid = lo + (hi - lo) / 2;
+    const auto [cmp, num] = compare(_suffixes[mid], std::min(lo_lcp, hi_lcp));
+    if(cmp < 0){
+      lo = mid + 1;
+      lo_lcp = num;
+    }
+    else{
+      hi = mid;
+      hi_lcp = num;
+    }
   }
-  else {
-    
-    if(match_num == itr->first.size()) {
-      _insert(sv.data() + match_num, *itr->second);
+  const size_t beg {lo};
+
+  // First suffix past the lower bound that does not start with the fragment
+  hi = _suffixes.size();
+  lo_lcp = fragment.size();
+  hi_lcp = 0;
+  while(lo < hi){
+    const size_t mid = lo + (hi - lo) / 2;
+    const auto [cmp, num] = compare(_suffixes[mid], std::min(lo_lcp, hi_lcp));
+    if(cmp == 0){
+      lo = mid + 1;
+      lo_lcp = num;
     }
-    else {
-    
-      auto& par = std::get<1>(n.children.emplace_back(
-        std::make_pair(
-          std::basic_string_view<value_type, traits_type>{sv.data(), match_num}, new Node))
-      );
-
-      par->children.emplace_back(
-        std::make_pair(itr->first.data()+match_num, std::move(itr->second))
-      );
-
-      n.children.erase(itr);
-      
-      _insert(sv.data() + match_num, *par);
+    else{
+      hi = mid;
+      hi_lcp = num;
     }
   }
+  return {beg, lo};
 }
 
+// Function: count_substring
+// Return the number of occurrences of the fragment, counting a word once per position
+template <typename C>
+size_t SuffixIndex<C>::count_substring(view_type fragment) const {
+  if(fragment.empty()){
+    return 0;
+  }
+  const auto [beg, end] = _range(fragment);
+  return end - beg;
+}
 
-// Procedure: root
-// Return the root of RadixTree 
+// Function: match_substring
+// Return the words that contain the fragment, each once and in the order they were indexed
 template <typename C>
-const typename RadixTree<C>::Node& RadixTree<C>::root() const{
-  return _root;
+std::vector<C> SuffixIndex<C>::match_substring(view_type fragment) const {
+  if(fragment.empty()){
+    return {};
+  }
+  const auto [beg, end] = _range(fragment);
+  std::vector<uint32_t> ids;
+  ids.reserve(end - beg);
+  for(size_t i=beg; i<end; ++i){
+    ids.push_back(_suffixes[i].word);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  std::vector<C> words;
+  words.reserve(ids.size());
+  for(auto id: ids){
+    words.emplace_back(_word(id));
+  }
+  return words;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -402,11 +4056,365 @@ enum class COLOR{
   WHITE
 };
 
+// How TAB completes the command word
+enum class COMPLETION{
+  PREFIX,          // words starting with the line
+  SUBSEQUENCE,     // words containing the line as a subsequence, best first
+  SUBSTRING        // words containing the line anywhere
+};
+
+// Class: HistoryRing
+// Command history kept in a ring of strings. Lines are indexed from the oldest, pushing a 
+// line into a full ring overwrites the oldest one in place and reuses its storage, and 
+// slots are only allocated as the history grows towards its capacity.
+class HistoryRing {
+
+  public:
+
+   HistoryRing(size_t, std::pmr::memory_resource* = std::pmr::get_default_resource());
+
+   size_t size() const { return _slots.size(); }
+   size_t capacity() const { return _capacity; }
+   bool empty() const { return _slots.empty(); }
+
+   std::pmr::string& operator [] (size_t i) { return _slots[_slot(i)]; }
+   const std::pmr::string& operator [] (size_t i) const { return _slots[_slot(i)]; }
+
+   std::pmr::string& back() { return (*this)[size()-1]; }
+   const std::pmr::string& back() const { return (*this)[size()-1]; }
+
+   void push_back(std::string_view);
+   void set_capacity(size_t);
+   void clear();
+
+  private:
+
+   size_t _capacity;
+   size_t _head {0};   // slot of the oldest line once the ring is full
+   std::pmr::vector<std::pmr::string> _slots;
+
+   size_t _slot(size_t i) const { return _head + i < _slots.size() ? _head + i : _head + i - _slots.size(); }
+};
+
+// Procedure: Ctor
+inline HistoryRing::HistoryRing(size_t capacity, std::pmr::memory_resource* mr) : 
+  _capacity(capacity), 
+  _slots(mr) {
+}
+
+// Procedure: push_back
+// Append a line, evicting the oldest one when the ring is full
+inline void HistoryRing::push_back(std::string_view line){
+  if(_slots.size() < _capacity){
+    _slots.emplace_back(line);
+  }
+  else if(_capacity > 0){
+    _slots[_head].assign(line.data(), line.size());
+    if(++_head == _slots.size()){
+      _head = 0;
+    }
+  }
+}
+
+// Procedure: set_capacity
+// Change the capacity; the newest lines are kept when it shrinks
+inline void HistoryRing::set_capacity(size_t capacity){
+  std::rotate(_slots.begin(), _slots.begin() + _head, _slots.end());
+  _head = 0;
+  if(_slots.size() > capacity){
+    _slots.erase(_slots.begin(), _slots.end() - capacity);
+  }
+  _capacity = capacity;
+}
+
+// Procedure: clear
+inline void HistoryRing::clear(){
+  _slots.clear();
+  _head = 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// When the history journal forces its writes to disk
+enum class FSYNC{
+  NEVER,      // leave it to the operating system
+  ON_CLOSE,   // once, when the journal is closed
+  ALWAYS      // after every batch of lines written
+};
+
+// Class: HistoryJournal
+// Append-only history file. Lines are appended to an in-memory batch under a lock and a 
+// writer thread moves each batch to the file, so accepting a line never waits on the disk. 
+// Compaction replaces the whole file with a snapshot by writing a temporary file next to it 
+// and renaming it over the journal; lines appended after the snapshot follow it in the file. 
+// If the rewrite fails the journal is kept and the lines the snapshot covered are appended 
+// to it as usual, so no line is lost either way. Lines the writer could not write, for 
+// instance because the file could not be opened, are kept and retried with the next batch.
+class HistoryJournal {
+
+  public:
+
+   HistoryJournal(const std::filesystem::path&, FSYNC = FSYNC::ON_CLOSE, size_t = 0);
+   ~HistoryJournal();
+
+   void append(std::string_view);
+   void compact(std::string);
+   void flush();
+
+   size_t lines() const { return _lines; }
+   bool compacting() const;
+   bool good() const { return _good; }
+
+   void set_sync(FSYNC sync) { _sync = sync; }
+
+  private:
+
+   std::filesystem::path _path;
+   std::atomic<FSYNC> _sync;
+
+   mutable std::mutex _mutex;
+   std::condition_variable _work;  // the writer waits for work
+   std::condition_variable _done;  // flush waits for the writer
+   std::string _batch;             // lines not yet handed to the writer
+   std::string _snapshot;          // full contents of a pending compaction
+   size_t _covered {0};            // bytes of the batch the snapshot holds
+   size_t _appended {0};           // lines appended, and the count when the snapshot was taken
+   size_t _appended_at_snapshot {0};
+   bool _compact {false};
+   bool _compacting {false};       // a compaction is queued or being written
+   bool _stop {false};
+   size_t _queued {0};             // batches handed over, and the number written
+   size_t _written {0};
+   std::atomic<size_t> _lines;     // lines in the file once everything queued is written
+   std::atomic<bool> _good {true}; // whether the last batch reached the file
+
+   int _fd {-1};
+   std::thread _writer;
+
+   void _write_loop();
+   bool _rewrite(const std::string&);
+   void _sync_directory() const;
+   static void _sync_data(int);
+   static size_t _write_all(int, std::string_view);
+};
+
+// Procedure: Ctor
+// Open the journal, which already holds the given number of lines
+inline HistoryJournal::HistoryJournal(const std::filesystem::path& path, FSYNC sync, size_t lines) : 
+  _path(path), 
+  _sync(sync),
+  _lines(lines) {
+  _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  _writer = std::thread([this](){ _write_loop(); });
+}
+
+// Procedure: Dtor
+// Write what is left and stop the writer
+inline HistoryJournal::~HistoryJournal(){
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _work.notify_one();
+  _writer.join();
+  if(_fd != -1){
+    if(_sync != FSYNC::NEVER){
+      ::fsync(_fd);
+    }
+    ::close(_fd);
+  }
+}
+
+// Procedure: append
+// Queue one line for the writer
+inline void HistoryJournal::append(std::string_view line){
+  {
+    std::lock_guard lock(_mutex);
+    _batch.append(line).push_back('\n');
+    ++_queued;
+    ++_appended;
+    ++_lines;
+  }
+  _work.notify_one();
+}
+
+// Procedure: compact
+// Queue a rewrite of the journal with the given contents, one line per '\n'. The snapshot 
+// is expected to hold every line appended so far: queued lines that were not written yet 
+// are skipped once the rewrite succeeds, and written after the old journal if it fails.
+inline void HistoryJournal::compact(std::string snapshot){
+  {
+    std::lock_guard lock(_mutex);
+    _snapshot = std::move(snapshot);
+    _covered = _batch.size();
+    _appended_at_snapshot = _appended;
+    _compact = true;
+    _compacting = true;
+    ++_queued;
+  }
+  _work.notify_one();
+}
+
+// Function: compacting
+// Check whether a compaction is queued or being written
+inline bool HistoryJournal::compacting() const {
+  std::lock_guard lock(_mutex);
+  return _compacting;
+}
+
+// Procedure: flush
+// Block until everything queued so far is in the file
+inline void HistoryJournal::flush(){
+  std::unique_lock lock(_mutex);
+  const size_t queued {_queued};
+  _done.wait(lock, [&](){ return _written >= queued; });
+}
+
+// Procedure: _write_loop
+// Writer thread: take the batch and any compaction, write them outside the lock, repeat. 
+// The buffers are swapped rather than copied so their capacity is reused. What a failed 
+// write leaves is carried over to the next round, where the file is opened again if needed.
+inline void HistoryJournal::_write_loop(){
+  std::string batch, snapshot, carry;
+  std::unique_lock lock(_mutex);
+  for(;;){
+    _work.wait(lock, [&](){ return _stop or _queued != _written; });
+    if(_queued == _written){
+      break;
+    }
+    const size_t queued {_queued};
+    const bool compact {_compact};
+    const size_t covered {_covered};
+    const size_t appended_at_snapshot {_appended_at_snapshot};
+    batch.swap(_batch);
+    snapshot.swap(_snapshot);
+    _compact = false;
+    lock.unlock();
+
+    std::string_view pending {batch};
+    bool compacted {false};
+    if(compact and _rewrite(snapshot)){
+      pending.remove_prefix(covered);
+      carry.clear();  // carried lines came before the snapshot, which holds them
+      compacted = true;
+    }
+    const size_t snapshot_lines = compacted ? std::count(snapshot.begin(), snapshot.end(), '\n') : 0;
+    snapshot.clear();
+    if(not carry.empty()){
+      carry.append(pending);
+      pending = carry;
+    }
+    if(_fd == -1){
+      _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    }
+    if(const size_t num = _fd == -1 ? 0 : _write_all(_fd, pending); num == pending.size()){
+      if(_sync == FSYNC::ALWAYS){
+        _sync_data(_fd);
+      }
+      carry.clear();
+      _good = true;
+    }
+    else{
+      std::string rest(pending.substr(num));
+      carry.swap(rest);
+      _good = false;
+    }
+    batch.clear();
+
+    lock.lock();
+    if(compacted){
+      _lines = snapshot_lines + (_appended - appended_at_snapshot);
+    }
+    if(compact){
+      _compacting = _compact;
+    }
+    _written = queued;
+    _done.notify_all();
+  }
+}
+
+// Function: _rewrite
+// Replace the journal by the snapshot through a temporary file and a rename, so a crash 
+// leaves either the old or the new journal. The temporary file gets the permissions of the 
+// journal it replaces (owner-only if there is none), since history can hold secrets, and 
+// its descriptor becomes the journal's, so nothing has to be reopened after the rename. 
+// Return false, keeping the old journal, if any step fails.
+inline bool HistoryJournal::_rewrite(const std::string& snapshot){
+  auto tmp = _path;
+  tmp += ".tmp";
+  const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+  if(fd == -1){
+    return false;
+  }
+  struct stat st;
+  bool ok = _fd == -1 or (::fstat(_fd, &st) == 0 and ::fchmod(fd, st.st_mode & 07777) == 0);
+  ok = ok and _write_all(fd, snapshot) == snapshot.size();
+  if(ok and _sync != FSYNC::NEVER){
+    ok = ::fsync(fd) == 0;
+  }
+  if(not ok or ::rename(tmp.c_str(), _path.c_str()) != 0){
+    ::close(fd);
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  if(_sync == FSYNC::ALWAYS){
+    _sync_directory();
+  }
+  if(_fd != -1){
+    ::close(_fd);
+  }
+  _fd = fd;
+  return true;
+}
+
+// Procedure: _sync_directory
+// Force the rename to disk: it is an entry of the parent directory, not of the file
+inline void HistoryJournal::_sync_directory() const {
+  const auto parent = _path.has_parent_path() ? _path.parent_path() : std::filesystem::path(".");
+  if(const int fd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); fd != -1){
+    ::fsync(fd);
+    ::close(fd);
+  }
+}
+
+// Procedure: _sync_data
+// Force the written lines to disk. fdatasync skips the metadata an append does not need but 
+// is optional in POSIX, so fsync stands in where the system lacks it.
+inline void HistoryJournal::_sync_data(int fd){
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+  ::fdatasync(fd);
+#else
+  ::fsync(fd);
+#endif
+}
+
+// Function: _write_all
+// Write the whole buffer, resuming after partial writes and signals. Return the number of 
+// bytes written, which is less than the buffer size on an error.
+inline size_t HistoryJournal::_write_all(int fd, std::string_view data){
+  size_t written {0};
+  while(written < data.size()){
+    const auto n = ::write(fd, data.data() + written, data.size() - written);
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      break;
+    }
+    written += n;
+  }
+  return written;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 class Prompt {
 
   struct LineInfo{
+
+    explicit LineInfo(std::pmr::memory_resource* mr) : buf(mr) {}
     
-    std::string buf;
+    std::pmr::string buf;
     int history_trace {0};
     size_t cur_pos {0};   // cursor position
 
@@ -426,7 +4434,8 @@ class Prompt {
       std::istream& = std::cin, 
       std::ostream& = std::cout, 
       std::ostream& = std::cerr,
-      int = STDIN_FILENO
+      int = STDIN_FILENO,
+      std::pmr::memory_resource* = std::pmr::get_default_resource()  // session memory
     );
 
     ~Prompt();
@@ -434,9 +4443,14 @@ class Prompt {
     bool readline(std::string&);
 
     void set_history_size(size_t);
+    void set_history_sync(FSYNC);
     size_t history_size() const { return _history.size(); };
     
-    void autocomplete(const std::string&);
+    void autocomplete(const std::string&);  // thread-safe
+    void autocomplete(WordTableView<std::string>);  // table must outlive the prompt
+
+    void set_completion_mode(COMPLETION);
+    void set_ignore_case(bool);
 
   private: 
   
@@ -449,10 +4463,13 @@ class Prompt {
     
     int _infd;
     size_t _columns {80};   // default width of terminal is 80
+
+    std::pmr::memory_resource* _memory;  // history, line buffers and file completions
     
-    RadixTree<std::string> _tree;  // Radix tree for command autocomplete
+    ConcurrentRadixTree<std::string> _tree;  // Radix tree for command autocomplete
+    std::vector<WordTableView<std::string>> _tables;  // Static command tables
   
-    std::string _obuf;      // Buffer for _refresh_single_line
+    std::pmr::string _obuf;  // Buffer for _refresh_single_line
 
     bool _unsupported_term();
     void _stdin_not_tty(std::string &);
@@ -461,9 +4478,14 @@ class Prompt {
 
     // History  
     size_t _max_history_size {100};
-    std::list<std::string> _history;
+    HistoryRing _history;
+    std::pmr::string _history_scratch;  // line being edited while browsing the history
+    FSYNC _history_sync {FSYNC::ON_CLOSE};
+    std::unique_ptr<HistoryJournal> _journal;  // opened by the first accepted line
+    size_t _history_file_lines {0};  // lines read from the history file at startup
+    bool _compact_pending {false};   // the file holds more lines than were read
     void _add_history(const std::string&);
-    void _save_history();
+    void _compact_history();
     void _load_history();
 
     termios _orig_termios;
@@ -481,15 +4503,37 @@ class Prompt {
     LineInfo _line;
     LineInfo _line_save;
 
+    size_t _max_fuzzy_edits {2};  // edit distance of "did you mean" suggestions
+    size_t _max_listed_commands {100};  // commands listed by one TAB
+
+    COMPLETION _completion {COMPLETION::PREFIX};
+    bool _ignore_case {false};
+
+    size_t _max_subsequence_matches {50};
+    SubsequenceMatcher<std::string> _subsequence;
+    std::atomic<bool> _subsequence_stale {true};  // words added since _subsequence was built
+
+    SuffixIndex<std::string> _substring;
+    std::atomic<bool> _substring_stale {true};  // words added since _substring was built
+
     int _autocomplete_iterate_command();
     void _autocomplete_command();
+    void _autocomplete_ignore_case();
+    void _suggest_similar_commands();
+    void _list_commands(std::vector<std::string>&, size_t);
+
+    template <typename F = NoFold>
+    size_t _count_commands(const RadixTree<std::string>&) const;
+
+    void _autocomplete_subsequence();
+    void _autocomplete_substring();
     void _autocomplete_folder();
 
-    std::vector<std::string> _files_in_folder(const std::filesystem::path&) const;
-    std::vector<std::string> _files_match_prefix(const std::filesystem::path&) const;
-    std::string _dump_files(const std::vector<std::string>&, const std::filesystem::path&);
+    std::pmr::vector<std::pmr::string> _files_in_folder(const std::filesystem::path&) const;
+    std::pmr::vector<std::pmr::string> _files_match_prefix(const std::filesystem::path&) const;
+    std::string _dump_files(const std::pmr::vector<std::pmr::string>&, const std::filesystem::path&);
     std::string _dump_options(const std::vector<std::string>&);
-    std::string _next_prefix(const std::vector<std::string>&, const size_t);
+    std::pmr::string _next_prefix(const std::pmr::vector<std::pmr::string>&, const size_t);
 
     std::filesystem::path _user_home() const;
     bool _has_read_access(const std::filesystem::path&) const;
@@ -523,14 +4567,21 @@ inline Prompt::Prompt(
   std::istream& in, 
   std::ostream& out, 
   std::ostream& err,
-  int infd
+  int infd,
+  std::pmr::memory_resource* mr
 ):
   _prompt(pmt), 
   _history_path(path),
   _cin(in),
   _cout(out),
   _cerr(err),
-  _infd(infd)
+  _infd(infd),
+  _memory(mr),
+  _obuf(mr),
+  _history(_max_history_size, mr),
+  _history_scratch(mr),
+  _line(mr),
+  _line_save(mr)
 {
   if(::isatty(_infd)){
     _cout << welcome_msg;
@@ -553,65 +4604,97 @@ inline Prompt::~Prompt(){
   if(_has_orig_termios){
     ::tcsetattr(_infd, TCSAFLUSH, &_orig_termios);
   }
-  if(not _history.empty()){
-    _save_history();
-  }
 }
 
 // Procedure: autocomplete
-// This function adds the word into radix tree
+// This function adds the word into radix tree. It can be called from any thread, 
+// including while another thread is blocked in readline.
 inline void Prompt::autocomplete(const std::string& word){
   _tree.insert(word);
+  _subsequence_stale = true;
+  _substring_stale = true;
+}
+
+// Procedure: autocomplete
+// Add a static command table, e.g. one built by make_word_table, as a completion source. 
+// The table is referred to, not copied. Unlike adding single words this is not thread-safe 
+// and is meant to be called before the first readline.
+inline void Prompt::autocomplete(WordTableView<std::string> table){
+  _tables.push_back(table);
+  _subsequence_stale = true;
+  _substring_stale = true;
+}
+
+// Procedure: set_completion_mode
+// Choose how TAB completes the command word
+inline void Prompt::set_completion_mode(COMPLETION mode){
+  _completion = mode;
+}
+
+// Procedure: set_ignore_case
+// Let prefix completion match commands regardless of ASCII case
+inline void Prompt::set_ignore_case(bool ignore){
+  _ignore_case = ignore;
 }
 
 // Procedure: history_size 
 // Change the max history size
 inline void Prompt::set_history_size(size_t new_size){
   _max_history_size = new_size;
+  _history.set_capacity(new_size);
 }
 
 
-// Procedure: _save_history 
-// Save history commands to a file
-inline void Prompt::_save_history(){
-  std::ofstream ofs(_history_path);
-  if(not ofs.good()){
-    return;
+// Procedure: set_history_sync
+// Choose when the history journal is forced to disk
+inline void Prompt::set_history_sync(FSYNC sync){
+  _history_sync = sync;
+  if(_journal){
+    _journal->set_sync(sync);
   }
-  
-  for(const auto& c: _history){
-    ofs << c << '\n';
+}
+
+// Procedure: _compact_history 
+// Rewrite the history file with the lines kept in memory
+inline void Prompt::_compact_history(){
+  std::string snapshot;
+  for(size_t i=0; i<_history.size(); ++i){
+    snapshot.append(_history[i]).push_back('\n');
   }
-  ofs.close();
+  _journal->compact(std::move(snapshot));
 }
 
 
 // Procedure: _load_history 
-// Load history commands from a file
+// Load the newest history commands from a file, reading only as much of it as is kept
 inline void Prompt::_load_history(){
-  if(std::filesystem::exists(_history_path)){
-    std::ifstream ifs(_history_path);
-    std::string placeholder;
-    while(std::getline(ifs, placeholder)){
-      if(_history.size() == _max_history_size){
-        _history.pop_front();
-      }
-      _history.emplace_back(std::move(placeholder));
-    }
-  }
+  const bool more = read_tail_lines(_history_path, _max_history_size, [&](std::string_view line){
+    _history.push_back(line);
+  });
+  // A file holding more lines than are kept is compacted with the first accepted line
+  _history_file_lines = _history.size();
+  _compact_pending = more;
 }
 
 // Procedure: _add_history 
 // Add command to history list
 inline void Prompt::_add_history(const std::string &hist){
   // hist cannot be empty and cannot be the same as the last one
-  if(hist.empty() or (not _history.empty() and _history.back() == hist)){
+  if(hist.empty() or (not _history.empty() and std::string_view(_history.back()) == hist)){
     return ;
   }
-  if(_history.size() == _max_history_size){
-    _history.pop_front();
+  _history.push_back(hist);
+
+  // Append the line to the journal and trim it once it has grown to twice the history size. 
+  // A compaction that failed leaves the journal long and is retried with the next line.
+  if(not _journal){
+    _journal = std::make_unique<HistoryJournal>(_history_path, _history_sync, _history_file_lines);
+  }
+  _journal->append(hist);
+  if(_compact_pending or (_journal->lines() > 2 * _max_history_size and not _journal->compacting())){
+    _compact_history();
+    _compact_pending = false;
   }
-  _history.emplace_back(hist);
 }
 
 // Procedure: _stdin_not_tty
@@ -813,7 +4896,9 @@ inline bool Prompt::_has_read_access(const std::filesystem::path &path) const {
 
 // Procedure: _next_prefix
 // Find the prefix among a set of strings starting from position n
-inline std::string Prompt::_next_prefix(const std::vector<std::string>& words, const size_t n){
+inline std::pmr::string Prompt::_next_prefix(
+  const std::pmr::vector<std::pmr::string>& words, const size_t n
+){
   if(words.empty()){
     return {};
   }
@@ -915,37 +5000,226 @@ inline std::string Prompt::_dump_options(const std::vector<std::string>& opts){
 // Procedure: _autocomplete_command
 // This is the main entry for command autocomplete
 inline void Prompt::_autocomplete_command(){
-  if(auto words = _tree.match_prefix(_line.buf); words.empty()){
+  if(_ignore_case){
+    _autocomplete_ignore_case();
+    return;
+  }
+  auto ext = _tree.read([&](const auto& t){ return t.common_extension(_line.buf); });
+  for(const auto& table: _tables){
+    // The extension over all sources is what the extensions of each source share
+    if(auto e = table.common_extension(_line.buf); not ext){
+      ext = std::move(e);
+    }
+    else if(e){
+      ext->resize(count_prefix<std::string>(*ext, *e));
+    }
+  }
+  if(not ext){
+    _suggest_similar_commands();
+  }
+  else if(not ext->empty()){
+    // Extend the line by what all matches share
+    _line.buf.insert(_line.cur_pos, *ext);
+    _line.cur_pos += ext->size();
+    _refresh_single_line(_line);
   }
   else{
-    if(auto suffix = _next_prefix(words, _line.cur_pos); not suffix.empty()){
-      _line.buf.insert(_line.cur_pos, suffix);
-      _line.cur_pos += suffix.size();
+    // The matches diverge right at the line: list the first page of them
+    auto [num, page] = _tree.read([&](const auto& t){ 
+      return std::make_pair(_count_commands(t), t.match_prefix(_line.buf, 0, _max_listed_commands));
+    });
+    for(const auto& table: _tables){
+      auto words = table.match_prefix(_line.buf, 0, _max_listed_commands);
+      page.insert(page.end(), std::make_move_iterator(words.begin()), std::make_move_iterator(words.end()));
     }
-    if(auto s = _dump_options(words); s.size() > 0){
-      s.append("\x1b[0K\n");
-      _cout << s;
+    _list_commands(page, num);
+  }
+}
+
+
+// Procedure: _autocomplete_ignore_case
+// Command autocomplete that ignores ASCII case. The matches keep their spelling: the line is 
+// replaced by their longest common prefix when that is at least as long as the line and 
+// spelled differently, and the first page of them is listed otherwise. As with exact case, 
+// the matches are counted and only the page is collected.
+inline void Prompt::_autocomplete_ignore_case(){
+  auto [num, common, page] = _tree.read([&](const auto& t){ 
+    return std::make_tuple(
+      _count_commands<AsciiFold>(t), 
+      t.template common_prefix<AsciiFold>(_line.buf),
+      t.template match_prefix<AsciiFold>(_line.buf, 0, _max_listed_commands)
+    );
+  });
+  for(const auto& table: _tables){
+    if(auto c = table.template common_prefix<AsciiFold>(_line.buf); not common){
+      common = std::move(c);
+    }
+    else if(c){
+      common->resize(count_prefix<std::string>(*common, *c));
+    }
+    size_t limit {_max_listed_commands};
+    table.template for_each_prefix<AsciiFold>(_line.buf, [&](std::string_view w){
+      if(limit > 0){
+        page.emplace_back(w);
+        --limit;
+      }
+    });
+  }
+  if(not common){
+    _suggest_similar_commands();
+  }
+  else if(common->size() >= _line.buf.size() and *common != std::string_view(_line.buf)){
+    _line.buf.assign(*common);
+    _line.cur_pos = _line.buf.size();
+    _refresh_single_line(_line);
+  }
+  else{
+    _list_commands(page, num);
+  }
+}
+
+
+// Procedure: _suggest_similar_commands
+// Nothing starts with the line: suggest the commands of all sources within a few typos of 
+// it, closest first and each once
+inline void Prompt::_suggest_similar_commands(){
+  auto similar = _tree.read([&](const auto& t){ 
+    return t.match_fuzzy(_line.buf, _max_fuzzy_edits); 
+  });
+  for(const auto& table: _tables){
+    auto words = table.match_fuzzy(_line.buf, _max_fuzzy_edits);
+    similar.insert(similar.end(), std::make_move_iterator(words.begin()), std::make_move_iterator(words.end()));
+  }
+  if(not _tables.empty()){
+    std::vector<std::pair<size_t, std::string>> ranked;
+    for(auto& w: similar){
+      ranked.emplace_back(edit_distance<std::string>(w, _line.buf, _max_fuzzy_edits), std::move(w));
+    }
+    std::sort(ranked.begin(), ranked.end());
+    ranked.erase(std::unique(ranked.begin(), ranked.end()), ranked.end());
+    similar.clear();
+    for(auto& r: ranked){
+      similar.push_back(std::move(r.second));
+    }
+  }
+  if(auto s = _dump_options(similar); s.size() > 0){
+    s.append("\x1b[0K\n");
+    _cout << s;
+    _refresh_single_line(_line);
+  }
+}
+
+
+// Function: _count_commands
+// Count the distinct commands that start with the line under the folding policy F. Tree 
+// words are counted from the subtree counts; a table word counts only when neither the tree 
+// nor an earlier table has it.
+template <typename F>
+inline size_t Prompt::_count_commands(const RadixTree<std::string>& t) const {
+  size_t num {t.template count_prefix_matches<F>(_line.buf)};
+  for(size_t i=0; i<_tables.size(); ++i){
+    _tables[i].template for_each_prefix<F>(_line.buf, [&](std::string_view w){
+      num += not t.exist(w) and std::none_of(_tables.begin(), _tables.begin()+i, [&](const auto& u){ 
+        return u.exist(w); 
+      });
+    });
+  }
+  return num;
+}
+
+// Procedure: _list_commands
+// List a page of matching commands gathered from all sources, out of num distinct ones. 
+// A command found in several sources is listed once, and at most _max_listed_commands are 
+// shown.
+inline void Prompt::_list_commands(std::vector<std::string>& page, size_t num){
+  std::sort(page.begin(), page.end());
+  page.erase(std::unique(page.begin(), page.end()), page.end());
+  if(page.size() > _max_listed_commands){
+    page.resize(_max_listed_commands);
+  }
+  if(auto s = _dump_options(page); s.size() > 0){
+    if(num > page.size()){
+      s.append("\n\r\x1b[0K... ").append(std::to_string(num - page.size())).append(" more");
     }
+    s.append("\x1b[0K\n");
+    _cout << s;
+  }
+  _refresh_single_line(_line);
+}
+
+
+// Procedure: _autocomplete_subsequence
+// Command autocomplete by subsequence: a single match replaces the line and several 
+// matches are listed best first. The index is rebuilt from the tree when words were added.
+inline void Prompt::_autocomplete_subsequence(){
+  if(_subsequence_stale.exchange(false)){
+    _subsequence = _tree.read([&](const auto& t){ 
+      SubsequenceMatcher<std::string> matcher(t);
+      for(const auto& table: _tables){
+        for(auto w: table){
+          if(not t.exist(w)){
+            matcher.insert(w);
+          }
+        }
+      }
+      return matcher;
+    });
+  }
+  if(auto words = _subsequence.match(_line.buf, _max_subsequence_matches); words.size() == 1){
+    _line.buf = words[0];
+    _line.cur_pos = _line.buf.size();
+  }
+  else if(auto s = _dump_options(words); s.size() > 0){
+    s.append("\x1b[0K\n");
+    _cout << s;
+  }
+  _refresh_single_line(_line);
+}
+
+
+// Procedure: _autocomplete_substring
+// Command autocomplete by substring: a single word containing the line replaces it and 
+// several are listed. The suffix index is rebuilt when words were added.
+inline void Prompt::_autocomplete_substring(){
+  if(_substring_stale.exchange(false)){
+    _substring = _tree.read([&](const auto& t){ 
+      // A word found in several sources is indexed once
+      auto words = t.all_words();
+      for(const auto& table: _tables){
+        words.insert(words.end(), table.begin(), table.end());
+      }
+      std::sort(words.begin(), words.end());
+      words.erase(std::unique(words.begin(), words.end()), words.end());
+      return SuffixIndex<std::string>(words.begin(), words.end());
+    });
+  }
+  if(auto words = _substring.match_substring(_line.buf); words.size() == 1){
+    _line.buf = words[0];
+    _line.cur_pos = _line.buf.size();
     _refresh_single_line(_line);
   }
+  else{
+    const size_t num = words.size();
+    _list_commands(words, num);
+  }
 }
 
 
 // Procedure: _files_match_prefix
 // Find all the files in a folder that match the prefix
-inline std::vector<std::string> Prompt::_files_match_prefix(
+inline std::pmr::vector<std::pmr::string> Prompt::_files_match_prefix(
   const std::filesystem::path& path
 ) const {
   // Need to check in case path is a file in current folder (parent_path = "")
   auto folder = path.filename() == path ? std::filesystem::current_path() : path.parent_path();
   std::string prefix(path.filename());
 
-  std::vector<std::string> matches; 
+  std::pmr::vector<std::pmr::string> matches(_memory); 
   if(std::error_code ec; _has_read_access(folder) and std::filesystem::is_directory(folder, ec)){
     for(const auto& p: std::filesystem::directory_iterator(folder)){
-      std::string fname {p.path().filename()};
+      const auto& fname = p.path().filename().native();
       if(fname.compare(0, prefix.size(), prefix) == 0){
-        matches.emplace_back(std::move(fname));
+        matches.emplace_back(fname);
       }
     }
   }
@@ -955,15 +5229,15 @@ inline std::vector<std::string> Prompt::_files_match_prefix(
 
 // Procedure: _files_in_folder
 // List all files in a given folder
-inline std::vector<std::string> Prompt::_files_in_folder(
+inline std::pmr::vector<std::pmr::string> Prompt::_files_in_folder(
   const std::filesystem::path& path
 ) const {
   auto p = path.empty() ? std::filesystem::current_path() : path;
-  std::vector<std::string> matches;
+  std::pmr::vector<std::pmr::string> matches(_memory);
   // Check permission 
   if(_has_read_access(p)){
     for(const auto& p: std::filesystem::directory_iterator(p)){
-      matches.emplace_back(p.path().filename());
+      matches.emplace_back(p.path().filename().native());
     }
   }
   return matches;
@@ -973,7 +5247,7 @@ inline std::vector<std::string> Prompt::_files_in_folder(
 // Procedure: _dump_files 
 // Format the strings for pretty print in terminal.
 inline std::string Prompt::_dump_files(
-  const std::vector<std::string>& v, 
+  const std::pmr::vector<std::pmr::string>& v, 
   const std::filesystem::path& path)
 {
   if(v.empty()){
@@ -999,7 +5273,7 @@ inline std::string Prompt::_dump_files(
       s.append("\n\r\x1b[0K");
     }
 
-    if(std::filesystem::is_directory(path.native() + "/" + v[i], ec)){
+    if(std::filesystem::is_directory(path / v[i], ec)){
       // A typical color code example : \033[31;1;4m 
       //   \033[ : begin of color code, 31 : red color,  1 : bold,  4 : underlined
       s.append(seq, strlen(seq)).append(v[i]).append("\033[0m");
@@ -1018,11 +5292,12 @@ inline std::string Prompt::_dump_files(
 inline void Prompt::_autocomplete_folder(){
   std::string s;
   size_t ws_index = _line.buf.rfind(' ', _line.cur_pos) + 1;
+  std::string_view buf {_line.buf};
 
   std::filesystem::path p(
-    _line.buf[ws_index] != '~' ? 
-    _line.buf.substr(ws_index, _line.cur_pos - ws_index) : 
-    _user_home().native() + _line.buf.substr(ws_index+1, _line.cur_pos-ws_index-1)
+    buf[ws_index] != '~' ? 
+    std::string(buf.substr(ws_index, _line.cur_pos - ws_index)) : 
+    _user_home().string().append(buf.substr(ws_index+1, _line.cur_pos-ws_index-1))
   );
 
   if(std::error_code ec; p.empty() or std::filesystem::is_directory(p, ec)) {
@@ -1103,20 +5378,24 @@ inline void Prompt::_key_next_history(LineInfo& line){
 }
 
 // Procedure:_key_history
-// Set the line buffer to previous/next history command
+// Set the line buffer to previous/next history command. Trace 0 is the line being edited 
+// and trace t the t-th newest history line; edits are kept when moving away from a line.
 inline void Prompt::_key_history(LineInfo &line, bool prev){
-  if(_history.size() > 1){
-    *std::next(_history.begin(), _history.size()-1-line.history_trace) = line.buf;
+  if(not _history.empty()){
+    auto entry = [&](int trace) -> std::pmr::string& {
+      return trace == 0 ? _history_scratch : _history[_history.size()-trace];
+    };
+
+    entry(line.history_trace) = line.buf;
 
     if(line.history_trace += prev ? 1 : -1; line.history_trace < 0){
       line.history_trace = 0;
     }
-    else if(line.history_trace >= static_cast<int>(_history.size())){
-      line.history_trace = _history.size()-1;
+    else if(line.history_trace > static_cast<int>(_history.size())){
+      line.history_trace = _history.size();
     }
     else{
-      auto it = std::next(_history.begin(), _history.size()-1-line.history_trace);
-      line.buf = *it;
+      line.buf = entry(line.history_trace);
       line.cur_pos = line.buf.size();
     }
   }
@@ -1208,7 +5487,7 @@ inline void Prompt::_edit_line(std::string &s){
     return;
   }
 
-  _history.emplace_back("");
+  _history_scratch.clear();
   _line.reset();
   s.clear();
   for(char c;;){
@@ -1226,6 +5505,14 @@ inline void Prompt::_edit_line(std::string &s){
         _autocomplete_folder();
         continue;
       }
+      else if(_completion == COMPLETION::SUBSEQUENCE){
+        _autocomplete_subsequence();
+        continue;
+      }
+      else if(_completion == COMPLETION::SUBSTRING){
+        _autocomplete_substring();
+        continue;
+      }
       else{
         _autocomplete_command();
         continue;
@@ -1243,7 +5530,6 @@ inline void Prompt::_edit_line(std::string &s){
     // Proceed to process character
     switch(static_cast<KEY>(c)){
       case KEY::ENTER:
-        _history.pop_back(); // Remove the emptry string history added in beginning  
         s =  _line.buf;
         return ;
       case KEY::CTRL_A:    // Go to the start of the line 
@@ -1259,7 +5545,6 @@ inline void Prompt::_edit_line(std::string &s){
         _refresh_single_line(_line);
         break;
       case KEY::CTRL_C:
-        _history.pop_back(); // Remove the emptry string history added in beginning  
         errno = EAGAIN;
         return ;
       case KEY::CTRL_D:    // Remove the char at the right of cursor. 
@@ -1269,7 +5554,6 @@ inline void Prompt::_edit_line(std::string &s){
           _refresh_single_line(_line);
         }
         else{
-          _history.pop_back();
           return;
         }
         break;
@@ -1326,7 +5610,6 @@ inline void Prompt::_edit_line(std::string &s){
         break;
       case KEY::ESC:
         if(not _key_handle_CSI(_line)){
-          _history.pop_back(); // Remove the emptry string history added in beginning  
           return;
         }
         _refresh_single_line(_line);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Memory resource that counts the bytes it hands out and takes back.
+// Shared by the unit tests and the benchmarks.
+class CountingResource : public std::pmr::memory_resource {
+
+  public:
+
+    size_t allocated {0};
+    size_t outstanding {0};
+
+  private:
+
+    void* do_allocate(size_t bytes, size_t align) override {
+      allocated += bytes;
+      outstanding += bytes;
+      return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+      outstanding -= bytes;
+      std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+      return this == &other;
+    }
+};
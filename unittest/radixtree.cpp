@@ -1,12 +1,23 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
+#include "counting_resource.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <cstring>
 #include <string_view>
 #include <random>
+#include <numeric>
+#include <map>
+#include <set>
+#include <mutex>
 #include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <memory_resource>
+#include <sstream>
+#include <iterator>
 
 #include "prompt.hpp"
 
@@ -165,6 +176,48 @@ void test_radix_tree_type(){
   }
 }
 
+template <typename C>
+void test_flat_radix_tree_type(){
+  const size_t word_num {1000};
+  const size_t word_len {20};
+
+  std::vector<C> words;
+  for(size_t i=0; i<word_num; i++){
+    words.emplace_back(gen_random<C>(word_len));
+  }
+
+  prompt::RadixTree<C> tree(words);
+  prompt::FlatRadixTree<C> flat(words);
+
+  // Both trees list the same words in the same order, whether built from the whole 
+  // vector or word by word
+  REQUIRE(flat.all_words() == tree.all_words());
+  {
+    prompt::RadixTree<C> incremental;
+    prompt::FlatRadixTree<C> flat_incremental;
+    for(const auto& w: words){
+      incremental.insert(w);
+      flat_incremental.insert(w);
+    }
+    REQUIRE(flat_incremental.all_words() == incremental.all_words());
+    for(size_t i=0; i<word_len; i+=4){
+      REQUIRE(flat_incremental.match_prefix(words[0].substr(0, i)) == incremental.match_prefix(words[0].substr(0, i)));
+    }
+  }
+
+  for(const auto& w: words){
+    REQUIRE(flat.exist(w));
+    for(size_t i=1; i<=w.size(); i++){
+      C s(w.data(), i);
+      REQUIRE(flat.exist(s) == tree.exist(s));
+
+      REQUIRE(flat.match_prefix(s) == tree.match_prefix(s));
+    }
+  }
+  REQUIRE(flat.match_prefix(C(word_len+1, 1)).empty());
+  REQUIRE(flat.dump().size() > 1);
+}
+
 TEST_CASE("RadixTree") {
   srand(time(nullptr));
   test_radix_tree_type<std::string>();        // Signed type
@@ -173,4 +226,1529 @@ TEST_CASE("RadixTree") {
   test_radix_tree_type<std::u32string>();     // Unsigned type
 }
 
+TEST_CASE("FlatRadixTree") {
+  srand(time(nullptr));
+  test_flat_radix_tree_type<std::string>();
+  test_flat_radix_tree_type<std::wstring>();
+  test_flat_radix_tree_type<std::u16string>();
+  test_flat_radix_tree_type<std::u32string>();
+}
+
+template <typename C>
+void test_radix_children_type(){
+  using Layout = typename prompt::RadixChildren<
+    C, typename prompt::RadixTree<C>::Node, typename prompt::RadixTree<C>::node_pointer
+  >::Layout;
+
+  // Fan out the root one first code unit at a time and walk through every layout
+  prompt::RadixTree<C> tree;
+  std::vector<C> words;
+  for(size_t i=1; i<=250; i++){
+    C w;
+    w.push_back(i);
+    w.push_back(i % 7 + 1);
+    words.push_back(w);
+    tree.insert(w);
+
+    const auto layout = tree.root().children.layout();
+    if(i <= 4)       REQUIRE(layout == Layout::SMALL);
+    else if(i <= 16) REQUIRE(layout == Layout::NODE16);
+    else if(i <= 48) REQUIRE(layout == Layout::NODE48);
+    else             REQUIRE(layout == Layout::NODE256);
+
+    for(const auto& v: words){
+      REQUIRE(tree.exist(v));
+      REQUIRE(tree.match_prefix(C(1, v[0])).size() == 1);
+    }
+    REQUIRE(not tree.exist(C(1, i+1)));
+  }
+
+  // Code units beyond the 256-way index
+  if constexpr(sizeof(typename C::value_type) > 1){
+    for(size_t i=300; i<340; i++){
+      tree.insert(C(2, i));
+    }
+    for(size_t i=300; i<340; i++){
+      REQUIRE(tree.exist(C(2, i)));
+      REQUIRE(not tree.exist(C(1, i)));
+    }
+    REQUIRE(tree.match_prefix(C(1, 341)).empty());
+  }
+  REQUIRE(not has_same_prefix<C>(tree.root()));
+}
+
+TEST_CASE("RadixChildren") {
+  test_radix_children_type<std::string>();
+  test_radix_children_type<std::wstring>();
+  test_radix_children_type<std::u16string>();
+  test_radix_children_type<std::u32string>();
+}
+
+template <typename C>
+void test_for_each_prefix_type(){
+  using view_type = std::basic_string_view<typename C::value_type, typename C::traits_type>;
+
+  std::vector<C> words;
+  for(size_t i=0; i<1000; i++){
+    words.emplace_back(gen_random<C>(20));
+  }
+  prompt::RadixTree<C> tree(words);
+
+  for(const auto& w: words){
+    C prefix(w.data(), rand()%w.size() + 1);
+
+    // Visiting every match gives each inserted word with the prefix once
+    std::vector<C> visited;
+    REQUIRE(tree.for_each_prefix(prefix, [&](view_type v){ visited.emplace_back(v); }));
+    std::vector<C> expect;
+    for(const auto& v: words){
+      if(is_prefix<C>(v, prefix)){
+        expect.push_back(v);
+      }
+    }
+    std::sort(expect.begin(), expect.end());
+    expect.erase(std::unique(expect.begin(), expect.end()), expect.end());
+    std::sort(visited.begin(), visited.end());
+    REQUIRE(visited == expect);
+
+    // Stop after the first match
+    size_t num {0};
+    REQUIRE(not tree.for_each_prefix(prefix, [&](view_type v){ 
+      REQUIRE(is_prefix<C>(v, prefix));
+      return ++num < 1; 
+    }));
+    REQUIRE(num == 1);
+  }
+}
+
+TEST_CASE("ForEachPrefix") {
+  srand(time(nullptr));
+  test_for_each_prefix_type<std::string>();
+  test_for_each_prefix_type<std::wstring>();
+  test_for_each_prefix_type<std::u16string>();
+  test_for_each_prefix_type<std::u32string>();
+}
+
+template <typename C>
+void test_top_k_type(){
+  prompt::RadixTree<C> tree;
+  std::unordered_map<C, size_t> weights;
+  for(size_t i=0; i<1000; i++){
+    auto w = gen_random<C>(10);
+    weights[w] = rand() % 100;
+    tree.insert(w, weights[w]);
+  }
+
+  // Lower the weight of some words so that the subtree maximums must be recomputed
+  for(auto& [w, weight]: weights){
+    if(rand() % 4 == 0){
+      weight = weight / 2;
+      tree.insert(w, weight);
+    }
+    // Inserting without weight keeps the weight
+    tree.insert(w);
+  }
+
+  for(const auto& [w, weight]: weights){
+    C prefix(w.data(), rand()%w.size() + 1);
+    const size_t k = rand() % 20 + 1;
+
+    std::vector<size_t> expect;
+    for(const auto& m: tree.match_prefix(prefix)){
+      expect.push_back(weights.at(m));
+    }
+    std::sort(expect.begin(), expect.end(), std::greater<size_t>());
+    expect.resize(std::min(k, expect.size()));
+
+    std::vector<size_t> ret;
+    for(const auto& m: tree.top_k(prefix, k)){
+      REQUIRE(is_prefix<C>(m, prefix));
+      ret.push_back(weights.at(m));
+    }
+    REQUIRE(ret == expect);
+  }
+}
+
+TEST_CASE("TopK") {
+  srand(time(nullptr));
+  test_top_k_type<std::string>();
+  test_top_k_type<std::wstring>();
+  test_top_k_type<std::u16string>();
+  test_top_k_type<std::u32string>();
+}
+
+template <typename C>
+void test_frozen_radix_tree_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<5000; i++){
+    words.emplace_back(gen_random<C>(20));
+  }
+  // Words that are prefixes of other words
+  for(size_t i=0; i<500; i++){
+    words.emplace_back(words[i].substr(0, words[i].size()/2));
+  }
+
+  prompt::RadixTree<C> tree(words);
+  auto frozen = tree.freeze();
+
+  auto expect = tree.all_words();
+  auto ret = frozen.all_words();
+  std::sort(expect.begin(), expect.end());
+  std::sort(ret.begin(), ret.end());
+  REQUIRE(ret == expect);
+
+  for(const auto& w: words){
+    for(size_t i=1; i<=w.size(); i++){
+      C s(w.data(), i);
+      REQUIRE(frozen.exist(s) == tree.exist(s));
+      auto m1 = frozen.match_prefix(s);
+      auto m2 = tree.match_prefix(s);
+      std::sort(m1.begin(), m1.end());
+      std::sort(m2.begin(), m2.end());
+      REQUIRE(m1 == m2);
+    }
+  }
+  REQUIRE(not frozen.exist(C{}));
+
+  // Save the image and map it back
+  const auto path = std::filesystem::temp_directory_path() / 
+                    ("prompt_frozen_" + std::to_string(::getpid()) + ".img");
+  frozen.save(path);
+  {
+    auto mapped = prompt::FrozenRadixTree<C>::open(path);
+    REQUIRE(mapped.num_bytes() == frozen.num_bytes());
+    REQUIRE(mapped.num_nodes() == frozen.num_nodes());
+    REQUIRE(mapped.all_words() == frozen.all_words());
+    for(const auto& w: words){
+      REQUIRE(mapped.exist(w) == not w.empty());
+      REQUIRE(mapped.match_prefix(w.substr(0, 1)) == frozen.match_prefix(w.substr(0, 1)));
+    }
+
+    // An image of a different code unit width is rejected
+    if constexpr(not std::is_same_v<C, std::string>){
+      REQUIRE_THROWS_AS(prompt::FrozenRadixTree<std::string>::open(path), std::runtime_error);
+    }
+  }
+  {
+    // Images with a valid header but a corrupted payload are rejected
+    std::vector<uint64_t> image(frozen.num_bytes() / 8);
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(image.data()), frozen.num_bytes());
+    const uint64_t num_nodes {image[3]}, louds_bits {image[4]}, louds {image[5]}; 
+    const uint64_t louds_rank {image[6]}, label_offsets {image[8]};
+
+    auto corrupt = [&](auto&& modify){
+      auto copy = image;
+      modify(copy);
+      std::ofstream(path, std::ios::binary | std::ios::trunc).write(
+        reinterpret_cast<const char*>(copy.data()), copy.size() * 8
+      );
+      REQUIRE_THROWS_AS(prompt::FrozenRadixTree<C>::open(path), std::runtime_error);
+    };
+
+    corrupt([&](auto& img){ img[4] = louds_bits - 2; });
+    corrupt([&](auto& img){ img[louds + (louds_bits-1)/64] ^= uint64_t{1} << ((louds_bits-1) % 64); });
+    corrupt([&](auto& img){ img[louds] ^= 2; });
+    corrupt([&](auto& img){ reinterpret_cast<uint32_t*>(img.data() + louds_rank)[1] += 1; });
+    corrupt([&](auto& img){ reinterpret_cast<uint32_t*>(img.data() + label_offsets)[num_nodes] += 1000000; });
+    corrupt([&](auto& img){ 
+      auto offsets = reinterpret_cast<uint32_t*>(img.data() + label_offsets);
+      std::swap(offsets[num_nodes/2], offsets[num_nodes/2 + 1]);
+    });
+  }
+  {
+    // A truncated image is rejected
+    frozen.save(path);
+    std::filesystem::resize_file(path, frozen.num_bytes() - 8);
+    REQUIRE_THROWS_AS(prompt::FrozenRadixTree<C>::open(path), std::runtime_error);
+  }
+  std::filesystem::remove(path);
+  REQUIRE_THROWS_AS(prompt::FrozenRadixTree<C>::open(path), std::runtime_error);
+
+  // An empty tree has only the root
+  prompt::FrozenRadixTree<C> empty;
+  REQUIRE(empty.num_nodes() == 1);
+  REQUIRE(empty.all_words().empty());
+  REQUIRE(not empty.exist(words[0]));
+}
+
+TEST_CASE("FrozenRadixTree") {
+  srand(time(nullptr));
+  test_frozen_radix_tree_type<std::string>();
+  test_frozen_radix_tree_type<std::wstring>();
+  test_frozen_radix_tree_type<std::u16string>();
+  test_frozen_radix_tree_type<std::u32string>();
+}
+
+template <typename C>
+void test_bulk_load_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<3000; i++){
+    words.emplace_back(gen_random<C>(20));
+  }
+  for(size_t i=0; i<300; i++){
+    words.emplace_back(words[i].substr(0, words[i].size()/2));  // Prefixes and empty strings
+    words.emplace_back(words[i]);                               // Duplicates
+  }
+
+  prompt::RadixTree<C> incremental;
+  for(const auto& w: words){
+    incremental.insert(w);
+  }
+
+  // Unsorted input is sorted before loading
+  prompt::RadixTree<C> unsorted(words.begin(), words.end());
+
+  // Sorted input is loaded as is
+  std::sort(words.begin(), words.end());
+  prompt::RadixTree<C> sorted(words.begin(), words.end());
+
+  for(const auto* tree: {&unsorted, &sorted}){
+    REQUIRE(not has_same_prefix<C>(tree->root()));
+    // The radix tree of a word set is unique, so the frozen forms must be identical
+    auto f1 = tree->freeze();
+    auto f2 = incremental.freeze();
+    REQUIRE(f1.num_nodes() == f2.num_nodes());
+    REQUIRE(f1.all_words() == f2.all_words());
+    for(const auto& w: words){
+      for(size_t i=1; i<=w.size(); i++){
+        C s(w.data(), i);
+        REQUIRE(tree->exist(s) == incremental.exist(s));
+      }
+    }
+  }
+}
+
+// Forward iterator that yields each word as a temporary copy
+struct TemporaryIterator {
+  using iterator_category = std::forward_iterator_tag;
+  using value_type        = std::string;
+  using difference_type   = std::ptrdiff_t;
+  using pointer           = void;
+  using reference         = std::string;
+
+  const std::vector<std::string>* words;
+  size_t i;
+
+  std::string operator * () const { return (*words)[i]; }
+  TemporaryIterator& operator ++ () { ++i; return *this; }
+  TemporaryIterator operator ++ (int) { auto t = *this; ++i; return t; }
+  bool operator == (const TemporaryIterator& rhs) const { return i == rhs.i; }
+  bool operator != (const TemporaryIterator& rhs) const { return i != rhs.i; }
+};
+
+TEST_CASE("BulkLoad") {
+  srand(time(nullptr));
+  test_bulk_load_type<std::string>();
+  test_bulk_load_type<std::wstring>();
+  test_bulk_load_type<std::u16string>();
+  test_bulk_load_type<std::u32string>();
+
+  // Ranges that do not refer to lasting strings are copied before loading
+  std::vector<std::string> words {"report", "read", "write", "read_verilog", "re"};
+  std::ostringstream oss;
+  for(const auto& w: words){
+    oss << w << ' ';
+  }
+  std::istringstream iss(oss.str()), iss2(oss.str());
+  prompt::RadixTree<std::string> streamed(
+    std::istream_iterator<std::string>{iss}, std::istream_iterator<std::string>{}
+  );
+  prompt::RadixTree<std::string> parallel(
+    std::istream_iterator<std::string>{iss2}, std::istream_iterator<std::string>{}, 4
+  );
+  TemporaryIterator first {&words, 0}, last {&words, words.size()};
+  prompt::RadixTree<std::string> temporaries(first, last);
+  prompt::RadixTree<std::string> temporaries_parallel(first, last, 4);
+
+  std::sort(words.begin(), words.end());
+  REQUIRE(streamed.all_words() == words);
+  REQUIRE(parallel.all_words() == words);
+  REQUIRE(temporaries.all_words() == words);
+  REQUIRE(temporaries_parallel.all_words() == words);
+}
+
+template <typename C>
+void test_parallel_build_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<5000; i++){
+    words.emplace_back(gen_random<C>(20));
+  }
+  for(size_t i=0; i<500; i++){
+    words.emplace_back(words[i].substr(0, words[i].size()/2));
+    words.emplace_back(words[i]);
+  }
+
+  // The parallel build must give the same tree as the sequential one
+  prompt::RadixTree<C> sequential(words.begin(), words.end());
+  for(size_t num_threads: {1, 2, 4, 16}){
+    prompt::RadixTree<C> parallel(words.begin(), words.end(), num_threads);
+    REQUIRE(parallel.dump() == sequential.dump());
+    REQUIRE(parallel.all_words() == sequential.all_words());
+  }
+
+  prompt::RadixTree<C> empty(words.end(), words.end(), 4);
+  REQUIRE(empty.all_words().empty());
+}
+
+TEST_CASE("ParallelBuild") {
+  srand(time(nullptr));
+  test_parallel_build_type<std::string>();
+  test_parallel_build_type<std::wstring>();
+  test_parallel_build_type<std::u16string>();
+  test_parallel_build_type<std::u32string>();
+}
+
+template <typename C>
+void test_concurrent_radix_tree_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<500; i++){
+    words.emplace_back(gen_random<C>(20));
+  }
+
+  prompt::ConcurrentRadixTree<C> tree;
+  std::atomic<size_t> inserted {0};
+  std::atomic<size_t> errors {0};
+
+  // Readers check that every word inserted before they looked is visible. Assertions 
+  // are counted and checked on the main thread.
+  std::vector<std::thread> readers;
+  for(size_t r=0; r<3; r++){
+    readers.emplace_back([&, r](){
+      while(inserted.load() < words.size()){
+        const size_t n = inserted.load();
+        for(size_t i=r; i<n; i+=37){
+          errors += not tree.exist(words[i]);
+        }
+        errors += tree.read([&](const auto& t){ return has_same_prefix<C>(t.root()); });
+      }
+    });
+  }
+
+  std::thread writer([&](){
+    for(size_t i=0; i<words.size(); ){
+      if(i % 2 == 0){
+        tree.insert(words[i++]);
+      }
+      else{
+        tree.insert(words.begin()+i, words.begin()+i+1);
+        ++i;
+      }
+      inserted.store(i);
+    }
+  });
+
+  writer.join();
+  for(auto& r: readers){
+    r.join();
+  }
+  REQUIRE(errors.load() == 0);
+
+  prompt::RadixTree<C> expect(words);
+  auto ret = tree.all_words();
+  auto ans = expect.all_words();
+  std::sort(ret.begin(), ret.end());
+  std::sort(ans.begin(), ans.end());
+  REQUIRE(ret == ans);
+}
+
+TEST_CASE("ConcurrentRadixTree") {
+  srand(time(nullptr));
+  test_concurrent_radix_tree_type<std::string>();
+  test_concurrent_radix_tree_type<std::u32string>();
+
+  // A single-pass range reaches both copies: the next write makes the other one active
+  prompt::ConcurrentRadixTree<std::string> tree;
+  std::istringstream is("set get report reset");
+  tree.insert(std::istream_iterator<std::string>(is), std::istream_iterator<std::string>());
+  const std::vector<std::string> expect {"get", "report", "reset", "set"};
+  auto words = tree.all_words();
+  std::sort(words.begin(), words.end());
+  REQUIRE(words == expect);
+  tree.erase("none");
+  words = tree.all_words();
+  std::sort(words.begin(), words.end());
+  REQUIRE(words == expect);
+}
+
+template <typename C>
+void test_erase_type(){
+  std::unordered_map<C, size_t> weights;
+  for(size_t i=0; i<3000; i++){
+    auto w = gen_random<C>(10);
+    weights[w] = rand() % 100;
+    if(i % 3 == 0){
+      weights[w.substr(0, w.size()/2 + 1)] = rand() % 100;  // Words on inner nodes
+    }
+  }
+
+  prompt::RadixTree<C> tree;
+  for(const auto& [w, weight]: weights){
+    tree.insert(w, weight);
+  }
+
+  // Erase half of the words
+  std::vector<C> erased;
+  for(auto itr=weights.begin(); itr!=weights.end(); ){
+    if(rand() % 2){
+      REQUIRE(tree.erase(itr->first));
+      REQUIRE(not tree.erase(itr->first));
+      erased.push_back(itr->first);
+      itr = weights.erase(itr);
+    }
+    else{
+      ++itr;
+    }
+  }
+
+  auto check = [&](){
+    std::vector<C> remain;
+    for(const auto& [w, weight]: weights){
+      REQUIRE(tree.exist(w));
+      remain.push_back(w);
+    }
+    for(const auto& w: erased){
+      REQUIRE(tree.exist(w) == (weights.count(w) != 0));
+    }
+
+    // Merged chains leave the same tree as building the remaining words from scratch
+    REQUIRE(not has_same_prefix<C>(tree.root()));
+    prompt::RadixTree<C> expect(remain);
+    REQUIRE(tree.freeze().num_nodes() == expect.freeze().num_nodes());
+
+    // The subtree maximums are kept after erasing
+    for(const auto& [w, weight]: weights){
+      auto top = tree.top_k(w.substr(0, 1), 1);
+      size_t best {0};
+      for(const auto& m: tree.match_prefix(w.substr(0, 1))){
+        best = std::max(best, weights.at(m));
+      }
+      REQUIRE(weights.at(top.at(0)) == best);
+    }
+  };
+  check();
+
+  // Erase every word under some prefixes
+  for(size_t i=0; i<50 and not weights.empty(); i++){
+    auto w = weights.begin()->first;
+    auto prefix = w.substr(0, rand() % w.size() + 1);
+    REQUIRE(tree.erase_prefix(prefix));
+    REQUIRE(not tree.erase_prefix(prefix));
+    REQUIRE(tree.match_prefix(prefix).empty());
+    for(auto itr=weights.begin(); itr!=weights.end(); ){
+      if(is_prefix<C>(itr->first, prefix)){
+        erased.push_back(itr->first);
+        itr = weights.erase(itr);
+      }
+      else{
+        ++itr;
+      }
+    }
+  }
+  check();
+
+  REQUIRE(tree.erase_prefix(C{}) == not weights.empty());
+  REQUIRE(tree.all_words().empty());
+  REQUIRE(tree.root().children.empty());
+}
+
+TEST_CASE("Erase") {
+  srand(time(nullptr));
+  test_erase_type<std::string>();
+  test_erase_type<std::wstring>();
+  test_erase_type<std::u16string>();
+  test_erase_type<std::u32string>();
+}
+
+template <typename C>
+size_t edit_distance(const C& a, const C& b){
+  std::vector<size_t> prev(b.size()+1), curr(b.size()+1);
+  std::iota(prev.begin(), prev.end(), 0);
+  for(size_t i=1; i<=a.size(); i++){
+    curr[0] = i;
+    for(size_t j=1; j<=b.size(); j++){
+      curr[j] = std::min({prev[j]+1, curr[j-1]+1, prev[j-1] + (a[i-1] != b[j-1])});
+    }
+    std::swap(prev, curr);
+  }
+  return prev[b.size()];
+}
+
+template <typename C>
+void test_match_fuzzy_type(){
+  // A small alphabet so that words are close to each other
+  std::vector<C> words;
+  for(size_t i=0; i<2000; i++){
+    C w;
+    for(size_t j=rand()%8+1; j>0; j--){
+      w.push_back('a' + rand()%4);
+    }
+    words.push_back(w);
+  }
+  prompt::RadixTree<C> tree(words);
+  auto all = tree.all_words();
+  std::sort(all.begin(), all.end());
+  using view_type = typename prompt::WordTableView<C>::view_type;
+  const std::vector<view_type> views(all.begin(), all.end());
+  const prompt::WordTableView<C> table(views.data(), views.size());
+
+  for(size_t i=0; i<100; i++){
+    auto query = words[rand() % words.size()];
+    query[rand() % query.size()] = 'a' + rand()%5;
+    for(size_t max_edits: {0, 1, 2}){
+      // The banded distance is exact up to the limit
+      for(const auto& w: all){
+        REQUIRE(prompt::edit_distance<C>(w, query, max_edits) == std::min(edit_distance(w, query), max_edits+1));
+      }
+
+      // A static table gives the same matches, closest first
+      auto listed = table.match_fuzzy(query, max_edits);
+      for(size_t j=1; j<listed.size(); j++){
+        REQUIRE(edit_distance(listed[j-1], query) <= edit_distance(listed[j], query));
+      }
+      std::sort(listed.begin(), listed.end());
+
+      auto ret = tree.match_fuzzy(query, max_edits);
+      // Closest first
+      for(size_t j=1; j<ret.size(); j++){
+        REQUIRE(edit_distance(ret[j-1], query) <= edit_distance(ret[j], query));
+      }
+      std::vector<C> expect;
+      for(const auto& w: all){
+        if(edit_distance(w, query) <= max_edits){
+          expect.push_back(w);
+        }
+      }
+      std::sort(ret.begin(), ret.end());
+      std::sort(expect.begin(), expect.end());
+      REQUIRE(ret == expect);
+      REQUIRE(listed == expect);
+    }
+  }
+}
+
+TEST_CASE("MatchFuzzy") {
+  srand(time(nullptr));
+  test_match_fuzzy_type<std::string>();
+  test_match_fuzzy_type<std::wstring>();
+  test_match_fuzzy_type<std::u16string>();
+  test_match_fuzzy_type<std::u32string>();
+}
+
+template <typename C>
+bool is_subsequence(const C& word, const C& query){
+  auto lower = [](auto c){ return (c >= 'A' and c <= 'Z') ? c - 'A' + 'a' : c; };
+  size_t q {0};
+  for(size_t i=0; i<word.size() and q<query.size(); i++){
+    q += lower(word[i]) == lower(query[q]);
+  }
+  return q == query.size();
+}
+
+template <typename C>
+void test_subsequence_matcher_type(){
+  auto S = [](const char* s){ return C(s, s+strlen(s)); };
+
+  // Boundary and consecutive matches rank first
+  prompt::RadixTree<C> tree;
+  for(auto w: {"read_celllib", "report_delay_calc", "read_verilog", "redirect_cell", 
+               "ReadCellLib", "rd_cl", "write_celllib"}){
+    tree.insert(S(w));
+  }
+  prompt::SubsequenceMatcher<C> matcher(tree);
+  REQUIRE(matcher.size() == 7);
+
+  auto ret = matcher.match(S("rdcl"), 3);
+  REQUIRE(ret.size() == 3);
+  REQUIRE(ret[0] == S("rd_cl"));
+  REQUIRE(std::find(ret.begin(), ret.end(), S("read_celllib")) != ret.end());
+  REQUIRE(std::find(ret.begin(), ret.end(), S("ReadCellLib")) != ret.end());
+  REQUIRE(matcher.match(S("RDCL"), 10).size() == matcher.match(S("rdcl"), 10).size());
+  REQUIRE(matcher.match(S("xyz"), 10).empty());
+  REQUIRE(matcher.match(S(""), 10).empty());
+
+  // Random words against brute force
+  std::vector<C> words;
+  for(size_t i=0; i<3000; i++){
+    C w;
+    for(size_t j=rand()%12+1; j>0; j--){
+      w.push_back("abcdeABCDE_01"[rand()%13]);
+    }
+    words.push_back(w);
+  }
+  prompt::SubsequenceMatcher<C> random(words.begin(), words.end());
+  for(size_t i=0; i<100; i++){
+    C query;
+    for(size_t j=rand()%4+1; j>0; j--){
+      query.push_back("abcde_1"[rand()%7]);
+    }
+    std::vector<C> expect;
+    for(const auto& w: words){
+      if(is_subsequence(w, query)){
+        expect.push_back(w);
+      }
+    }
+    auto all = random.match(query, words.size());
+    std::sort(all.begin(), all.end());
+    std::sort(expect.begin(), expect.end());
+    REQUIRE(all == expect);
+
+    auto top = random.match(query, 10);
+    REQUIRE(top.size() == std::min<size_t>(10, expect.size()));
+    for(const auto& w: top){
+      REQUIRE(is_subsequence(w, query));
+    }
+  }
+
+  // Const matching is safe from several threads at once
+  const std::vector<C> queries {C(1, 'a'), C(2, 'b'), C(3, 'c'), C(1, '_')};
+  std::vector<std::vector<C>> expect;
+  for(const auto& q: queries){
+    expect.push_back(random.match(q, 20));
+  }
+  std::atomic<size_t> mismatches {0};
+  std::vector<std::thread> threads;
+  for(size_t t=0; t<4; t++){
+    threads.emplace_back([&, t](){
+      for(size_t r=0; r<50; r++){
+        const size_t q = (t + r) % queries.size();
+        mismatches += random.match(queries[q], 20) != expect[q];
+      }
+    });
+  }
+  for(auto& t: threads){
+    t.join();
+  }
+  REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("SubsequenceMatcher") {
+  srand(time(nullptr));
+  test_subsequence_matcher_type<std::string>();
+  test_subsequence_matcher_type<std::wstring>();
+  test_subsequence_matcher_type<std::u16string>();
+  test_subsequence_matcher_type<std::u32string>();
+}
+
+template <typename C>
+void test_common_extension_type(const C& lead){
+  // Every word starts with the leading run, so even the empty prefix has an extension
+  std::vector<C> words;
+  for(size_t i=0; i<2000; i++){
+    C w {lead};
+    for(size_t j=rand()%10+1; j>0; j--){
+      w.push_back('a' + rand()%3);
+    }
+    words.push_back(w);
+  }
+  prompt::RadixTree<C> tree(words);
+  REQUIRE(tree.common_extension(C()) == lead);
+
+  for(const auto& w: words){
+    for(size_t i=0; i<=w.size(); i++){
+      C prefix(w.data(), i);
+      C query = prefix;
+      query.push_back('a' + rand()%4);
+      for(const auto& p: {prefix, query}){
+        // Longest common prefix of all matches beyond p
+        auto matches = tree.match_prefix(p);
+        auto ext = tree.common_extension(p);
+        if(matches.empty()){
+          REQUIRE(not ext);
+          continue;
+        }
+        size_t len {matches[0].size()};
+        for(const auto& m: matches){
+          len = std::min(len, prompt::count_prefix<C>(m, matches[0]));
+        }
+        REQUIRE(ext);
+        REQUIRE(*ext == matches[0].substr(p.size(), len - p.size()));
+      }
+    }
+  }
+}
+
+TEST_CASE("CommonExtension") {
+  srand(time(nullptr));
+  test_common_extension_type<std::string>("");
+  test_common_extension_type<std::string>("read_");
+  test_common_extension_type<std::wstring>(L"read_");
+  test_common_extension_type<std::u16string>(u"read_");
+  test_common_extension_type<std::u32string>(U"read_");
+  REQUIRE(prompt::RadixTree<std::string>().common_extension("") == std::nullopt);
+}
+
+template <typename C>
+void test_count_prefix_type(){
+  for(size_t len=0; len<200; len++){
+    C a;
+    for(size_t i=0; i<len; i++){
+      a.push_back('a' + rand()%26);
+    }
+    for(size_t pos=0; pos<=len; pos++){
+      C b {a};
+      if(pos < len){
+        // Flip a high bit too so wide code units differ outside the low byte
+        b[pos] = static_cast<typename C::value_type>(b[pos] ^ (sizeof(b[pos]) > 1 ? 0x100 : 0x1));
+      }
+      REQUIRE(prompt::count_prefix<C>(a, b) == pos);
+      REQUIRE(prompt::count_prefix<C>(b, a) == pos);
+      REQUIRE(prompt::count_prefix<C>(a, C(b.data(), pos)) == pos);
+      REQUIRE(prompt::count_prefix<C>(C(a.data(), pos), b) == pos);
+    }
+  }
+}
+
+TEST_CASE("CountPrefix") {
+  srand(time(nullptr));
+  test_count_prefix_type<std::string>();
+  test_count_prefix_type<std::wstring>();
+  test_count_prefix_type<std::u16string>();
+  test_count_prefix_type<std::u32string>();
+}
+
+template <typename C>
+void test_prefix_count_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<3000; i++){
+    C w;
+    for(size_t j=rand()%8+1; j>0; j--){
+      w.push_back('a' + rand()%4);
+    }
+    words.push_back(w);
+  }
+
+  // Check counts, pages and unique resolution against the full match
+  auto check = [](const prompt::RadixTree<C>& tree, const std::vector<C>& queries){
+    REQUIRE(tree.count_prefix_matches({}) == tree.all_words().size());
+    for(size_t j=0; j<queries.size(); j+=17){
+      const auto& q = queries[j];
+      for(size_t i=0; i<=q.size(); i++){
+        C prefix(q.data(), i);
+        auto all = tree.match_prefix(prefix);
+        REQUIRE(tree.count_prefix_matches(prefix) == all.size());
+        for(size_t offset: {size_t{0}, size_t{1}, all.size()/3, all.size()}){
+          for(size_t limit: {size_t{0}, size_t{1}, size_t{7}, all.size()}){
+            auto page = tree.match_prefix(prefix, offset, limit);
+            const size_t beg = std::min(offset, all.size());
+            const size_t end = std::min(offset + limit, all.size());
+            REQUIRE(page == std::vector<C>(all.begin() + beg, all.begin() + end));
+          }
+        }
+        auto unique = tree.resolve_unique(prefix);
+        REQUIRE(unique.has_value() == (all.size() == 1));
+        if(unique){
+          REQUIRE(*unique == all[0]);
+        }
+      }
+    }
+  };
+
+  // Incremental insertion
+  prompt::RadixTree<C> tree;
+  for(const auto& w: words){
+    tree.insert(w);
+  }
+  check(tree, words);
+
+  // Bulk load and parallel build
+  check(prompt::RadixTree<C>(words), words);
+  check(prompt::RadixTree<C>(words.begin(), words.end(), 4), words);
+
+  // Weighted reinsertion and removal
+  for(size_t i=0; i<words.size(); i+=3){
+    tree.insert(words[i], rand()%10);
+    tree.erase(words[i+1 < words.size() ? i+1 : i]);
+  }
+  for(size_t i=0; i<words.size(); i+=97){
+    tree.erase_prefix(C(words[i].data(), std::min(words[i].size(), size_t{3})));
+  }
+  check(tree, words);
+}
+
+TEST_CASE("PrefixCount") {
+  srand(time(nullptr));
+  test_prefix_count_type<std::string>();
+  test_prefix_count_type<std::wstring>();
+  test_prefix_count_type<std::u16string>();
+  test_prefix_count_type<std::u32string>();
+}
+
+template <typename C>
+void test_radix_map_type(){
+  prompt::RadixMap<C, size_t> map;
+  std::map<C, size_t> ref;
+
+  // Check every operation against the ordered reference map
+  auto check = [&](){
+    REQUIRE(map.size() == ref.size());
+    for(const auto& [k, v]: ref){
+      REQUIRE(map.find(k) != nullptr);
+      REQUIRE(*map.find(k) == v);
+      for(size_t i=0; i<=k.size(); i++){
+        C prefix(k.data(), i);
+        auto beg = ref.lower_bound(prefix);
+        auto end = beg;
+        while(end != ref.end() and end->first.compare(0, prefix.size(), prefix) == 0){
+          ++end;
+        }
+        auto matches = map.find_prefix(prefix);
+        REQUIRE(matches.size() == static_cast<size_t>(std::distance(beg, end)));
+        for(const auto& [word, value]: matches){
+          REQUIRE(ref.at(word) == *value);
+        }
+        auto unique = map.resolve_unique(prefix);
+        REQUIRE((unique != nullptr) == (std::next(beg) == end));
+        if(unique){
+          REQUIRE(*unique == beg->second);
+        }
+      }
+      // A proper extension of a word is not a word unless inserted
+      C longer = k;
+      longer.push_back('z');
+      REQUIRE(map.find(longer) == nullptr);
+    }
+  };
+
+  for(size_t i=0; i<500; i++){
+    C w;
+    for(size_t j=rand()%8+1; j>0; j--){
+      w.push_back('a' + rand()%4);
+    }
+    auto [value, added] = map.insert(w, i);
+    REQUIRE(added == (ref.count(w) == 0));
+    REQUIRE(*value == i);
+    ref[w] = i;
+  }
+  check();
+
+  // Values are handed out by pointer and can be updated in place
+  for(auto& [k, v]: ref){
+    *map.find(k) = ++v;
+  }
+  check();
+
+  auto itr = ref.begin();
+  while(itr != ref.end()){
+    REQUIRE(map.erase(itr->first));
+    REQUIRE(not map.erase(itr->first));
+    itr = ref.erase(itr);
+    if(itr != ref.end()){
+      ++itr;
+    }
+  }
+  check();
+
+  for(auto& [k, v]: ref){
+    map.erase(k);
+  }
+  REQUIRE(map.empty());
+  REQUIRE(map.find_prefix({}).empty());
+}
+
+TEST_CASE("RadixMap") {
+  srand(time(nullptr));
+  test_radix_map_type<std::string>();
+  test_radix_map_type<std::wstring>();
+  test_radix_map_type<std::u16string>();
+  test_radix_map_type<std::u32string>();
+}
+
+// Memory resource that records the threads allocating from it
+class ThreadRecordingResource : public std::pmr::memory_resource {
+
+  public:
+
+    std::set<std::thread::id> threads;
+
+  private:
+
+    std::mutex _mutex;
+
+    void* do_allocate(size_t bytes, size_t align) override {
+      std::scoped_lock lock(_mutex);
+      threads.insert(std::this_thread::get_id());
+      return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+      return this == &other;
+    }
+};
+
+template <typename C>
+void test_allocator_type(){
+  using P = std::basic_string<
+    typename C::value_type, typename C::traits_type, 
+    std::pmr::polymorphic_allocator<typename C::value_type>
+  >;
+
+  std::vector<C> words;
+  std::vector<P> pmr_words;
+  for(size_t i=0; i<2000; i++){
+    words.push_back(gen_random<C>(rand()%20 + 1));
+    pmr_words.emplace_back(words.back().data(), words.back().size());
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+
+  // Every node, edge label and child table of the tree comes from the resource
+  CountingResource counter;
+  std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  {
+    prompt::RadixTree<P> tree(&counter);
+    for(const auto& w: pmr_words){
+      tree.insert(w);
+    }
+    REQUIRE(counter.allocated > 0);
+    for(size_t i=0; i<pmr_words.size(); i+=2){
+      tree.erase(pmr_words[i]);
+    }
+    for(size_t i=0; i<pmr_words.size(); i+=2){
+      tree.insert(pmr_words[i]);
+    }
+    std::pmr::set_default_resource(nullptr);
+    REQUIRE(tree.count_prefix_matches({}) == words.size());
+    for(const auto& w: words){
+      REQUIRE(tree.exist(std::basic_string_view<typename C::value_type>(w.data(), w.size())));
+    }
+  }
+  REQUIRE(counter.outstanding == 0);
+
+  // Bulk load into an arena that is released at once, and build in parallel from a 
+  // thread-safe pool
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::synchronized_pool_resource pool;
+  prompt::RadixTree<P> bulk(pmr_words, &arena);
+  prompt::RadixTree<P> parallel(pmr_words.begin(), pmr_words.end(), 4, &pool);
+  REQUIRE(bulk.get_allocator().resource() == &arena);
+  REQUIRE(parallel.get_allocator().resource() == &pool);
+  REQUIRE(bulk.dump() == parallel.dump());
+  REQUIRE(bulk.count_prefix_matches({}) == words.size());
+
+  // A resource that is not thread-safe is only used from the calling thread
+  ThreadRecordingResource recorder;
+  prompt::RadixTree<P> sequential(pmr_words.begin(), pmr_words.end(), 4, &recorder);
+  REQUIRE(bulk.dump() == sequential.dump());
+  REQUIRE(recorder.threads == std::set<std::thread::id>{std::this_thread::get_id()});
+}
+
+TEST_CASE("Allocator") {
+  srand(time(nullptr));
+  test_allocator_type<std::string>();
+  test_allocator_type<std::wstring>();
+  test_allocator_type<std::u16string>();
+  test_allocator_type<std::u32string>();
+}
+
+// The table is built and queried entirely at compile time
+static constexpr auto commands = prompt::make_word_table(
+  "report_timing", "read_verilog", "read_celllib", "", "read_sdc", "report_slack", "read_sdc"
+);
+static_assert(commands.size() == 5);
+static_assert(commands.exist("read_sdc"));
+static_assert(not commands.exist("read"));
+static_assert(not commands.exist(""));
+static_assert(commands.count_prefix_matches("read_") == 3);
+static_assert(commands.count_prefix_matches("rep") == 2);
+static_assert(commands.count_prefix_matches("write") == 0);
+static_assert(commands.count_prefix_matches("") == 5);
+static_assert(*commands.begin() == "read_celllib");
+
+template <typename C>
+void test_word_table_type(){
+
+  constexpr size_t N {300};
+  using view_type = typename prompt::WordTableView<C>::view_type;
+
+  // Non-empty words with a common first code unit, so the empty prefix has an extension
+  std::vector<C> words;
+  for(size_t i=0; i<N; i++){
+    C w(1, 'r');
+    for(size_t j=rand()%6; j>0; j--){
+      w.push_back('a' + rand()%3);
+    }
+    words.push_back(w);
+  }
+
+  std::array<view_type, N> views;
+  std::copy(words.begin(), words.end(), views.begin());
+  prompt::StaticWordTable<C, N> table(views);
+  prompt::RadixTree<C> tree(words);
+
+  REQUIRE(table.size() == tree.all_words().size());
+  REQUIRE(std::is_sorted(table.begin(), table.end()));
+  REQUIRE(table.common_extension(view_type()) == tree.common_extension(view_type()));
+  REQUIRE(tree.common_extension(view_type())->substr(0, 1) == C(1, 'r'));
+
+  for(const auto& w: words){
+    for(size_t i=0; i<=w.size(); i++){
+      for(C prefix: {C(w.data(), i), C(w.data(), i) + C(1, 'd')}){
+        auto expect = tree.match_prefix(prefix);
+        std::sort(expect.begin(), expect.end());
+        REQUIRE(table.exist(prefix) == tree.exist(prefix));
+        REQUIRE(table.match_prefix(prefix) == expect);
+        REQUIRE(table.count_prefix_matches(prefix) == expect.size());
+        REQUIRE(table.common_extension(prefix) == tree.common_extension(prefix));
+        auto page = table.view().match_prefix(prefix, 1, 2);
+        REQUIRE(page.size() == std::min(size_t{2}, expect.size() - std::min(size_t{1}, expect.size())));
+      }
+    }
+  }
+}
+
+TEST_CASE("WordTable") {
+  srand(time(nullptr));
+  test_word_table_type<std::string>();
+  test_word_table_type<std::wstring>();
+  test_word_table_type<std::u16string>();
+  test_word_table_type<std::u32string>();
+}
+
+// Procedure: count_shape
+// Count nodes, label code units and words per depth by an independent traversal
+template <typename N>
+void count_shape(const N& n, size_t depth, size_t& nodes, size_t& units, std::vector<size_t>& depths){
+  ++nodes;
+  if(n.is_word){
+    depths.resize(std::max(depths.size(), depth+1));
+    ++depths[depth];
+  }
+  for(const auto& [k, v]: n.children){
+    units += k.size();
+    count_shape(*v, depth+1, nodes, units, depths);
+  }
+}
+
+template <typename C>
+void test_stats_type(){
+  prompt::RadixTree<C> tree;
+  REQUIRE(tree.stats().num_nodes == 1);
+  REQUIRE(tree.stats().num_words == 0);
+
+  for(size_t i=0; i<2000; i++){
+    tree.insert(gen_random<C>(rand()%40 + 1));
+  }
+
+  auto stats = tree.stats();
+
+  size_t nodes {0}, units {0};
+  std::vector<size_t> depths;
+  count_shape(tree.root(), 0, nodes, units, depths);
+
+  REQUIRE(stats.num_nodes == nodes);
+  REQUIRE(stats.num_words == tree.all_words().size());
+  REQUIRE(stats.label_code_units == units);
+  REQUIRE(stats.depth_histogram == depths);
+  REQUIRE(stats.max_depth + 1 >= depths.size());
+  REQUIRE(std::accumulate(stats.fanout_histogram.begin(), stats.fanout_histogram.end(), size_t{0}) == nodes);
+  REQUIRE(stats.fanout_histogram[0] > 0);
+  REQUIRE(stats.heap_bytes >= stats.label_bytes + (nodes - 1) * sizeof(typename prompt::RadixTree<C>::Node));
+  REQUIRE(stats.average_word_depth > 0);
+}
+
+TEST_CASE("Stats") {
+  srand(time(nullptr));
+  test_stats_type<std::string>();
+  test_stats_type<std::wstring>();
+  test_stats_type<std::u16string>();
+  test_stats_type<std::u32string>();
+
+  // Long labels live on the heap and are counted there
+  prompt::RadixTree<std::string> tree;
+  tree.insert(std::string(100, 'a'));
+  tree.insert("b");
+  REQUIRE(tree.stats().label_bytes >= 101);
+  
+  std::ostringstream oss;
+  oss << tree.stats();
+  REQUIRE(oss.str().find("nodes=3 words=2") == 0);
+}
+
+TEST_CASE("StreamDump") {
+  srand(time(nullptr));
+  std::vector<std::string> words;
+  std::vector<std::wstring> wwords;
+  for(size_t i=0; i<1000; i++){
+    words.push_back(gen_random<std::string>(20));
+    wwords.push_back(gen_random<std::wstring>(20));
+  }
+
+  prompt::RadixTree<std::string> tree(words);
+  std::ostringstream oss;
+  tree.dump(oss);
+  REQUIRE(oss.str() == tree.dump());
+
+  prompt::RadixTree<std::wstring> wtree(wwords);
+  std::wostringstream woss;
+  wtree.dump(woss);
+  REQUIRE(woss.str() == wtree.dump());
+}
+
+// Function: fold_word
+// Fold a word with a policy for the brute-force reference
+template <typename F, typename C>
+C fold_word(C w){
+  for(auto& c: w){
+    c = F::fold(c);
+  }
+  return w;
+}
+
+template <typename C, typename F>
+void test_case_fold_type(){
+  // Mixed-case words over a small alphabet so that several spellings of a word coexist
+  std::vector<C> words;
+  for(size_t i=0; i<1500; i++){
+    C w;
+    for(size_t j=rand()%6+1; j>0; j--){
+      const auto c = static_cast<typename C::value_type>('a' + rand()%3);
+      w.push_back(rand()%2 ? c : static_cast<typename C::value_type>(c - 'a' + 'A'));
+    }
+    words.push_back(w);
+  }
+  prompt::RadixTree<C> tree(words);
+  auto all = tree.all_words();
+
+  // The same words as a sorted table
+  std::vector<std::basic_string_view<typename C::value_type>> views(all.begin(), all.end());
+  std::sort(views.begin(), views.end());
+  prompt::WordTableView<C> table(views.data(), views.size());
+
+  for(size_t n=0; n<words.size(); n+=7){
+    const auto& w = words[n];
+    for(size_t i=0; i<=w.size(); i++){
+      // Flip the case of the query so it rarely matches exactly
+      C query = fold_word<F>(C(w.data(), i));
+      for(auto& c: query){
+        if(rand()%2) c = static_cast<typename C::value_type>(c - 'a' + 'A');
+      }
+      std::vector<C> expect;
+      for(const auto& a: all){
+        if(a.size() >= query.size() and fold_word<F>(a.substr(0, query.size())) == fold_word<F>(query)){
+          expect.push_back(a);
+        }
+      }
+      auto matches = tree.template match_prefix<F>(query);
+      for(size_t offset: {size_t{0}, size_t{3}}){
+        const auto beg = std::min(offset, matches.size());
+        const auto end = std::min(offset + 5, matches.size());
+        REQUIRE(tree.template match_prefix<F>(query, offset, 5) == 
+                std::vector<C>(matches.begin() + beg, matches.begin() + end));
+      }
+      std::sort(matches.begin(), matches.end());
+      std::sort(expect.begin(), expect.end());
+      REQUIRE(matches == expect);
+      REQUIRE(table.template match_prefix<F>(query) == expect);
+
+      std::optional<C> common;
+      for(const auto& e: expect){
+        common = common ? common->substr(0, prompt::count_prefix<C>(*common, e)) : e;
+      }
+      REQUIRE(tree.template common_prefix<F>(query) == common);
+      REQUIRE(table.template common_prefix<F>(query) == common);
+      REQUIRE(tree.template count_prefix_matches<F>(query) == expect.size());
+      REQUIRE(tree.template exist<F>(query) == std::any_of(all.begin(), all.end(), [&](const auto& a){
+        return not query.empty() and fold_word<F>(a) == fold_word<F>(query);
+      }));
+      REQUIRE(prompt::count_prefix<C, F>(query, fold_word<F>(w)) == i);
+    }
+  }
+  
+  // Without folding the original behavior is kept
+  REQUIRE(tree.template match_prefix<prompt::NoFold>(C()).size() == all.size());
+}
+
+TEST_CASE("CaseFold") {
+  srand(time(nullptr));
+  test_case_fold_type<std::string, prompt::AsciiFold>();
+  test_case_fold_type<std::wstring, prompt::AsciiFold>();
+  test_case_fold_type<std::u16string, prompt::SimpleCaseFold>();
+  test_case_fold_type<std::u32string, prompt::SimpleCaseFold>();
+
+  // Simple folding of a few non-ASCII letters; UTF-8 bytes are left alone
+  REQUIRE(prompt::SimpleCaseFold::fold(U'\u00C9') == U'\u00E9');
+  REQUIRE(prompt::SimpleCaseFold::fold(U'\u00D7') == U'\u00D7');
+  REQUIRE(prompt::SimpleCaseFold::fold(u'\u0141') == u'\u0142');
+  REQUIRE(prompt::SimpleCaseFold::fold(u'\u0100') == u'\u0101');
+  REQUIRE(prompt::SimpleCaseFold::fold(U'\u0178') == U'\u00FF');
+  REQUIRE(prompt::SimpleCaseFold::fold(U'\u03A3') == U'\u03C3');
+  REQUIRE(prompt::SimpleCaseFold::fold(U'\u03C2') == U'\u03C3');
+  REQUIRE(prompt::SimpleCaseFold::fold(u'\u0416') == u'\u0436');
+  REQUIRE(prompt::SimpleCaseFold::fold(u'\u0401') == u'\u0451');
+  REQUIRE(prompt::SimpleCaseFold::fold(static_cast<char>(0xC3)) == static_cast<char>(0xC3));
+
+  prompt::RadixTree<std::u32string> tree;
+  tree.insert(U"\u00C9cole");
+  tree.insert(U"\u00E9t\u00E9");
+  REQUIRE(tree.exist<prompt::SimpleCaseFold>(U"\u00E9COLE"));
+  REQUIRE(tree.match_prefix<prompt::SimpleCaseFold>(U"\u00C9").size() == 2);
+  REQUIRE(tree.match_prefix<prompt::AsciiFold>(U"\u00C9").size() == 1);
+
+  // Static tables scan with the same policy
+  static constexpr auto commands = prompt::make_word_table("read_celllib", "Read_verilog", "report");
+  REQUIRE(commands.view().match_prefix<prompt::AsciiFold>("READ_").size() == 2);
+  REQUIRE(commands.view().common_prefix<prompt::AsciiFold>("REP") == "report");
+  REQUIRE(commands.view().common_prefix<prompt::AsciiFold>("READ_") == "");
+  REQUIRE(commands.view().common_prefix<prompt::AsciiFold>("WRITE") == std::nullopt);
+
+  // Variants list every spelling that folds alike, so the tree can look them up
+  REQUIRE(prompt::AsciiFold::variants('q') == std::array<char, 2>{'q', 'Q'});
+  REQUIRE(prompt::AsciiFold::variants('Q') == std::array<char, 2>{'q', 'Q'});
+  REQUIRE(prompt::AsciiFold::variants('_') == std::array<char, 2>{'_', '_'});
+  REQUIRE(prompt::SimpleCaseFold::enumerable<char>);
+  REQUIRE(not prompt::SimpleCaseFold::enumerable<char32_t>);
+}
+
+template <typename C>
+void test_substring_index_type(){
+  std::vector<C> words;
+  for(size_t i=0; i<1000; i++){
+    C w;
+    for(size_t j=rand()%12+1; j>0; j--){
+      w.push_back('a' + rand()%4);
+    }
+    words.push_back(w);
+  }
+  prompt::RadixTree<C> tree(words);
+  prompt::SuffixIndex<C> index(tree);
+  auto vocab = tree.all_words();
+  REQUIRE(index.size() == vocab.size());
+
+  for(size_t i=0; i<300; i++){
+    C fragment;
+    for(size_t j=rand()%5+1; j>0; j--){
+      fragment.push_back('a' + rand()%5);
+    }
+    std::vector<C> expect;
+    size_t occurrences {0};
+    for(const auto& w: vocab){
+      if(w.find(fragment) != C::npos){
+        expect.push_back(w);
+      }
+      for(size_t p=w.find(fragment); p!=C::npos; p=w.find(fragment, p+1)){
+        ++occurrences;
+      }
+    }
+    // Words come back once each, in the order they were indexed
+    REQUIRE(index.match_substring(fragment) == expect);
+    REQUIRE(index.count_substring(fragment) == occurrences);
+  }
+
+  REQUIRE(index.match_substring(C()).empty());
+  REQUIRE(prompt::SuffixIndex<C>().match_substring(words[0]).empty());
+}
+
+TEST_CASE("SubstringIndex") {
+  srand(time(nullptr));
+  test_substring_index_type<std::string>();
+  test_substring_index_type<std::wstring>();
+  test_substring_index_type<std::u16string>();
+  test_substring_index_type<std::u32string>();
+
+  std::vector<std::string> commands {"read_verilog", "write_verilog", "report_timing"};
+  prompt::SuffixIndex<std::string> index(commands.begin(), commands.end());
+  REQUIRE(index.match_substring("verilog") == std::vector<std::string>{"read_verilog", "write_verilog"});
+  REQUIRE(index.match_substring("_t") == std::vector<std::string>{"report_timing"});
+  REQUIRE(index.match_substring("xyz").empty());
+}
+
+TEST_CASE("HistoryRing") {
+  srand(time(nullptr));
+
+  // Lines are indexed from the oldest and a full ring drops its oldest line
+  const size_t capacity = rand()%20 + 1;
+  prompt::HistoryRing ring(capacity);
+  std::vector<std::string> lines;
+  for(size_t i=0; i<200; i++){
+    lines.push_back(gen_random<std::string>(rand()%10+1));
+    ring.push_back(lines.back());
+    REQUIRE(ring.size() == std::min(lines.size(), capacity));
+    for(size_t j=0; j<ring.size(); j++){
+      REQUIRE(std::string_view(ring[j]) == lines[lines.size() - ring.size() + j]);
+    }
+    REQUIRE(std::string_view(ring.back()) == lines.back());
+  }
+
+  // Shrinking keeps the newest lines and growing lets the ring fill again
+  ring.set_capacity(capacity / 2);
+  REQUIRE(ring.size() == capacity / 2);
+  for(size_t j=0; j<ring.size(); j++){
+    REQUIRE(std::string_view(ring[j]) == lines[lines.size() - ring.size() + j]);
+  }
+  ring.set_capacity(capacity * 2);
+  for(size_t i=0; i<capacity * 2; i++){
+    lines.push_back(gen_random<std::string>(rand()%10+1));
+    ring.push_back(lines.back());
+    for(size_t j=0; j<ring.size(); j++){
+      REQUIRE(std::string_view(ring[j]) == lines[lines.size() - ring.size() + j]);
+    }
+  }
+  REQUIRE(ring.size() == capacity * 2);
+
+  // Edits through the index stay in place
+  ring[0] = "edited";
+  REQUIRE(std::string_view(ring[0]) == "edited");
+
+  ring.clear();
+  REQUIRE(ring.empty());
+  ring.set_capacity(0);
+  ring.push_back("ignored");
+  REQUIRE(ring.empty());
+}
+
+std::string gen_line(){
+  std::string line(rand()%20+1, ' ');
+  for(auto& c: line){
+    c = 'a' + rand()%26;
+  }
+  return line;
+}
+
+std::vector<std::string> read_lines(const std::filesystem::path& path){
+  std::vector<std::string> lines;
+  std::ifstream ifs(path);
+  for(std::string line; std::getline(ifs, line); ){
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+TEST_CASE("HistoryJournal") {
+  srand(time(nullptr));
+  const auto path = std::filesystem::temp_directory_path() / 
+                    ("prompt_journal_" + std::to_string(::getpid()));
+  std::filesystem::remove(path);
+
+  std::vector<std::string> lines;
+  for(auto sync: {prompt::FSYNC::NEVER, prompt::FSYNC::ON_CLOSE, prompt::FSYNC::ALWAYS}){
+    prompt::HistoryJournal journal(path, sync);
 
+    // Lines are appended in order, on top of what earlier sessions wrote
+    for(size_t i=0; i<500; i++){
+      lines.push_back(gen_line());
+      journal.append(lines.back());
+    }
+    journal.flush();
+    REQUIRE(read_lines(path) == lines);
+
+    // Compaction replaces the file and later lines follow the snapshot
+    lines.erase(lines.begin(), lines.end() - 100);
+    std::string snapshot;
+    for(const auto& l: lines){
+      snapshot.append(l).push_back('\n');
+    }
+    journal.compact(std::move(snapshot));
+    for(size_t i=0; i<10; i++){
+      lines.push_back(gen_line());
+      journal.append(lines.back());
+    }
+    journal.flush();
+    REQUIRE(journal.lines() == lines.size());
+    REQUIRE(not journal.compacting());
+  }
+  REQUIRE(read_lines(path) == lines);
+  REQUIRE(not std::filesystem::exists(path.string() + ".tmp"));
+
+  // A failed rewrite keeps the journal and still writes the lines the snapshot covered
+  const auto tmp = path.string() + ".tmp";
+  std::filesystem::create_directory(tmp);
+  {
+    prompt::HistoryJournal journal(path, prompt::FSYNC::ALWAYS, lines.size());
+    for(size_t i=0; i<50; i++){
+      lines.push_back(gen_line());
+      journal.append(lines.back());
+    }
+    journal.compact(std::string("dropped\n"));
+    lines.push_back(gen_line());
+    journal.append(lines.back());
+    journal.flush();
+    REQUIRE(read_lines(path) == lines);
+    REQUIRE(journal.lines() == lines.size());
+    REQUIRE(not journal.compacting());
+
+    // Once the rewrite can go through, the next compaction succeeds
+    std::filesystem::remove(tmp);
+    lines.erase(lines.begin(), lines.end() - 20);
+    std::string snapshot;
+    for(const auto& l: lines){
+      snapshot.append(l).push_back('\n');
+    }
+    journal.compact(std::move(snapshot));
+    journal.flush();
+    REQUIRE(journal.lines() == lines.size());
+  }
+  REQUIRE(read_lines(path) == lines);
+
+  // Compaction keeps the permissions of the journal it replaces
+  namespace fs = std::filesystem;
+  fs::permissions(path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+  {
+    prompt::HistoryJournal journal(path);
+    journal.compact("kept\n");
+    journal.append("after");
+  }
+  REQUIRE(read_lines(path) == std::vector<std::string>{"kept", "after"});
+  REQUIRE((fs::status(path).permissions() & fs::perms::all) == 
+          (fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read));
+  fs::remove(path);
+
+  // A journal that cannot be opened keeps its lines and writes them once it can
+  const auto dir = fs::temp_directory_path() / ("prompt_journal_dir_" + std::to_string(::getpid()));
+  fs::remove_all(dir);
+  {
+    prompt::HistoryJournal journal(dir / "history");
+    journal.append("first");
+    journal.flush();
+    REQUIRE(not journal.good());
+    fs::create_directory(dir);
+    journal.append("second");
+    journal.flush();
+    REQUIRE(journal.good());
+  }
+  REQUIRE(read_lines(dir / "history") == std::vector<std::string>{"first", "second"});
+  REQUIRE((fs::status(dir / "history").permissions() & fs::perms::all) == 
+          (fs::perms::owner_read | fs::perms::owner_write));
+  fs::remove_all(dir);
+}
+
+TEST_CASE("ReadTailLines") {
+  srand(time(nullptr));
+  const auto path = std::filesystem::temp_directory_path() / 
+                    ("prompt_tail_" + std::to_string(::getpid()));
+
+  for(size_t t=0; t<200; t++){
+    // Random lines, some empty, with or without a final newline. Every fourth file spans 
+    // several read chunks.
+    const size_t max_lines = t % 4 ? 50 : 3000;
+    std::string text;
+    for(size_t i=rand()%max_lines; i>0; i--){
+      text.append(rand()%5 ? gen_line() : std::string()).push_back('\n');
+    }
+    if(rand()%2 and not text.empty()){
+      text.pop_back();
+    }
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+
+    std::vector<std::string> all;
+    std::istringstream iss(text);
+    for(std::string line; std::getline(iss, line); ){
+      all.push_back(line);
+    }
+
+    const size_t num = rand()%(max_lines + 10);
+    std::vector<std::string> tail;
+    const bool more = prompt::read_tail_lines(path, num, [&](std::string_view line){
+      tail.emplace_back(line);
+    });
+    const size_t kept = std::min(num, all.size());
+    REQUIRE(tail == std::vector<std::string>(all.end() - kept, all.end()));
+    REQUIRE(more == (all.size() > num));
+  }
+
+  std::filesystem::remove(path);
+  REQUIRE(not prompt::read_tail_lines(path, 10, [](std::string_view){}));
+}